@@ -110,11 +110,15 @@ HEADERS += inc/win_structs.h \
     inc/squad.h \
     inc/skill.h \
     inc/scriptdialog.h \
+    inc/scansession.h \
     inc/scannerthread.h \
     inc/scannerjob.h \
+    inc/scannerconnection.h \
     inc/scanner.h \
+    inc/scanengine.h \
     inc/rotatedheader.h \
     inc/profession.h \
+    inc/pointerindex.h \
     inc/optionsmenu.h \
     inc/nullterminatedstringsearchjob.h \
     inc/militarypreference.h \
@@ -129,6 +133,8 @@ HEADERS += inc/win_structs.h \
     inc/dwarfjob.h \
     inc/dwarfdetailswidget.h \
     inc/dwarf.h \
+    inc/diffscan.h \
+    inc/dfinstancesnapshot.h \
     inc/dfinstance.h \
     inc/defines.h \
     inc/customprofession.h \
@@ -160,6 +166,7 @@ HEADERS += inc/win_structs.h \
     inc/stdstringsearchjob.h \
     inc/selectparentlayoutdialog.h \
     inc/layoutcreator.h \
+    inc/layoutdiscovery.h \
     inc/narrowingvectorsearchjob.h \
     inc/squadvectorsearchjob.h \
     inc/word.h \
@@ -175,9 +182,13 @@ SOURCES += src/viewmanager.cpp \
     src/squad.cpp \
     src/skill.cpp \
     src/scriptdialog.cpp \
+    src/scansession.cpp \
     src/scannerjob.cpp \
+    src/scannerconnection.cpp \
     src/scanner.cpp \
+    src/scanengine.cpp \
     src/rotatedheader.cpp \
+    src/pointerindex.cpp \
     src/optionsmenu.cpp \
     src/memorylayout.cpp \
     src/mainwindow.cpp \
@@ -188,6 +199,8 @@ SOURCES += src/viewmanager.cpp \
     src/dwarftherapist.cpp \
     src/dwarfdetailswidget.cpp \
     src/dwarf.cpp \
+    src/diffscan.cpp \
+    src/dfinstancesnapshot.cpp \
     src/dfinstance.cpp \
     src/customprofession.cpp \
     src/customcolor.cpp \
@@ -211,6 +224,7 @@ SOURCES += src/viewmanager.cpp \
     thirdparty/qtcolorpicker-2.6/qtcolorpicker.cpp \
     src/selectparentlayoutdialog.cpp \
     src/layoutcreator.cpp \
+    src/layoutdiscovery.cpp \
     src/word.cpp \
     src/raws/rawreader.cpp
 FORMS += ui/scriptdialog.ui \
@@ -231,3 +245,12 @@ RESOURCES += images.qrc
 
 OTHER_FILES += \
     src/dfinstanceosx.cpp
+
+# headless command line front end for scripting and benchmarking,
+# build with "qmake CONFIG+=cli"
+cli {
+    message(Building the command line tool)
+    TARGET = DwarfTherapistCli
+    SOURCES -= src/main.cpp
+    SOURCES += src/climain.cpp
+}
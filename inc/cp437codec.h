@@ -107,6 +107,12 @@ public:
 	CP437Codec(){}
 	~CP437Codec(){}
 
+	//! one codec for everybody; Qt owns registered codecs and frees them at exit
+	static CP437Codec *shared() {
+		static CP437Codec *codec = new CP437Codec;
+		return codec;
+	}
+
 	QByteArray name() const {
 		return "IBM437";
 	}
@@ -151,9 +157,11 @@ protected:
 					}
 				}
 		} else {
-			// Regular 437-encoded string.
-			while ( length-- > 0 )
-				str += QChar((unsigned int)cp437ToUnicode[*in++ & 0xFF]);
+			// Regular 437-encoded string, one table lookup per byte.
+			str.resize(length);
+			QChar *out = str.data();
+			for ( int i = 0; i < length; ++i )
+				out[i] = QChar(cp437ToUnicode[(uchar)in[i]]);
 		}
 		return str;
 	}
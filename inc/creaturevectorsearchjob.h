@@ -38,7 +38,14 @@ class CreatureVectorSearchJob : public ScannerJob {
 public:
     CreatureVectorSearchJob ()
         : ScannerJob(FIND_TRANSLATIONS_VECTOR)
+        , m_dwarf_race_index(0)
     {}
+
+    /*! (uncorrected) address of the dwarf race index, if it's been found.
+        Candidate vectors whose first creature isn't a dwarf are dropped */
+    void set_dwarf_race_index(const VIRTADDR &addr) {
+        m_dwarf_race_index = addr;
+    }
 public slots:
     void go() {
         if (!m_ok) {
@@ -61,24 +68,53 @@ public slots:
 
         emit scan_message(tr("Scanning for known nickname"));
         QByteArray needle(custom_nickname);
-        foreach(uint nickname_buf, m_df->scan_mem(needle)) {
+        // each level looks for pointers to everything the last one found, in
+        // a single pass
+        QVector<VIRTADDR> nickname_bufs = m_df->scan_mem(needle);
+        foreach(VIRTADDR nickname_buf, nickname_bufs) {
             LOGD << "FOUND NICKNAME" << hexify(nickname_buf);
-            foreach(uint nickname_str, m_df->scan_mem(encode(nickname_buf))) {
-                uint possible_addr = nickname_str - dwarf_nickname_offset -
-                                     m_df->memory_layout()->string_buffer_offset();
+        }
+
+        // one sweep for every pointer, then each level is just lookups
+        emit scan_message(tr("Indexing pointers"));
+        if (nickname_bufs.isEmpty() || !m_df->build_pointer_index()) {
+            emit quit();
+            return;
+        }
 
+        QVector<VIRTADDR> possible_addrs;
+        foreach(const QVector<VIRTADDR> &strs, m_df->scan_pointers(nickname_bufs)) {
+            foreach(VIRTADDR nickname_str, strs) {
+                VIRTADDR possible_addr = nickname_str - dwarf_nickname_offset -
+                                     m_df->memory_layout()->string_buffer_offset();
                 LOGD << "DWARF POINTER SHOULD BE AT:" << hexify(possible_addr);
-                foreach(uint dwarf, m_df->scan_mem(encode(possible_addr))) {
-                    LOGD << "FOUND DWARF" << hex << dwarf;
-                    emit scan_message(tr("Scanning for dwarf vector pointer"));
-                    // since this is the first dwarf, it should also be the vector
-                    foreach(uint vector_ptr, m_df->scan_mem(encode(dwarf))) {
-                        uint creature_vec = vector_ptr -
-                                            DFInstance::VECTOR_POINTER_OFFSET;
-                        emit found_address("creature_vector", creature_vec);
-                        LOGD << "FOUND CREATURE VECTOR" << hex << creature_vec;
-                    }
+                possible_addrs << possible_addr;
+            }
+        }
+
+        QVector<VIRTADDR> dwarves;
+        foreach(const QVector<VIRTADDR> &found, m_df->scan_pointers(possible_addrs)) {
+            foreach(VIRTADDR dwarf, found) {
+                LOGD << "FOUND DWARF" << hex << dwarf;
+                dwarves << dwarf;
+            }
+        }
+
+        if (!dwarves.isEmpty()) {
+            emit scan_message(tr("Scanning for dwarf vector pointer"));
+        }
+        // since this is the first dwarf, it should also be the vector
+        foreach(const QVector<VIRTADDR> &vector_ptrs, m_df->scan_pointers(dwarves)) {
+            foreach(VIRTADDR vector_ptr, vector_ptrs) {
+                VIRTADDR creature_vec = vector_ptr -
+                                        DFInstance::VECTOR_POINTER_OFFSET;
+                if (m_dwarf_race_index && !first_is_dwarf(creature_vec)) {
+                    LOGD << "SKIPPING" << hex << creature_vec
+                            << "first creature isn't a dwarf";
+                    continue;
                 }
+                emit found_address("creature_vector", creature_vec);
+                LOGD << "FOUND CREATURE VECTOR" << hex << creature_vec;
             }
         }
 
@@ -117,5 +153,17 @@ public slots:
 
         emit quit();
     }
+
+private:
+    VIRTADDR m_dwarf_race_index;
+
+    bool first_is_dwarf(const VIRTADDR &creature_vec) {
+        QVector<VIRTADDR> creatures = m_df->enumerate_vector(creature_vec);
+        if (creatures.isEmpty())
+            return false;
+        VIRTADDR race = creatures.first() +
+                        m_df->memory_layout()->dwarf_offset("race");
+        return m_df->read_word(race) == m_df->read_word(m_dwarf_race_index);
+    }
 };
 #endif // CREATUREVECTORSEARCHJOB_H
@@ -31,6 +31,26 @@ class Squad;
 class Word;
 class MemoryLayout;
 struct MemorySegment;
+class ScanReader;
+class ScanKernel;
+class PointerIndex;
+class ScanEngine;
+class DiffScan;
+
+/*! one (address, length, buffer) entry handed to DFInstance::read_batch(),
+    also used to describe the ranges of a write plan */
+struct ReadRequest {
+    ReadRequest(const VIRTADDR &_addr = 0, int _bytes = 0, void *_buffer = 0)
+        : addr(_addr)
+        , bytes(_bytes)
+        , buffer(_buffer)
+        , bytes_read(0)
+    {}
+    VIRTADDR addr;
+    int bytes;
+    void *buffer;
+    int bytes_read; // bytes transferred, filled in by read_batch()
+};
 
 class DFInstance : public QObject {
     Q_OBJECT
@@ -52,10 +72,20 @@ public:
 
     // brute force memory scanning methods
     bool is_valid_address(const VIRTADDR &addr);
+    //! the entries of addrs that point into mapped memory, in order
+    QVector<VIRTADDR> validate_pointers(const QVector<VIRTADDR> &addrs);
     bool looks_like_vector_of_pointers(const VIRTADDR &addr);
 
     // revamped memory reading
     virtual int read_raw(const VIRTADDR &addr, int bytes, QByteArray &buf) = 0;
+    //! read straight into caller-owned memory, no temporary QByteArray
+    int read_mem(const VIRTADDR &addr, int bytes, void *buffer);
+    //! fulfil many scattered reads with as few trips to the kernel as we can
+    int read_batch(QVector<ReadRequest> &requests);
+    /*! like read_batch(), but when DF is running under us (live reads) the
+        batch is read a second time and any request that changed is retried
+        until it holds still. Use it for hot structures like creatures. */
+    int read_stable(QVector<ReadRequest> &requests);
     virtual BYTE read_byte(const VIRTADDR &addr);
     virtual WORD read_word(const VIRTADDR &addr);
     virtual VIRTADDR read_addr(const VIRTADDR &addr);
@@ -65,8 +95,34 @@ public:
     // memory reading
     virtual QVector<VIRTADDR> enumerate_vector(const VIRTADDR &addr) = 0;
     virtual QString read_string(const VIRTADDR &addr) = 0;
+    /*! read_string() that also appends where the string lives to extents:
+        its struct and, unless they're inline, its characters */
+    QString read_tracked_string(const VIRTADDR &addr,
+                                QVector<ReadRequest> &extents);
 
     QVector<VIRTADDR> scan_mem(const QByteArray &needle, const uint start_addr=0, const uint end_addr=0xffffffff);
+    /*! find where each of targets is stored in one pass over memory, instead
+        of a scan_mem(encode(target)) per target. Returns target->sorted
+        addresses holding it, targets that weren't found are left out */
+    QHash<VIRTADDR, QVector<VIRTADDR> > scan_pointers(const QVector<VIRTADDR> &targets,
+                                                     const uint start_addr=0,
+                                                     const uint end_addr=0xffffffff);
+    /*! sweep memory once for every aligned pointer into DF's segments.
+        Until drop_pointer_index(), pointers_to() and scan_pointers() are
+        answered from that snapshot instead of scanning again (and only
+        see aligned pointers). Returns false if the sweep was cancelled */
+    bool build_pointer_index();
+    void drop_pointer_index();
+    bool has_pointer_index() {return m_pointer_index != 0;}
+    //! sorted addresses holding target
+    QVector<VIRTADDR> pointers_to(const VIRTADDR &target);
+    /*! the first pass of a differential scan, every value in the segments
+        we scan becomes a candidate. Returns false if it was cancelled */
+    bool start_diff_scan(DiffScan *scan);
+    /*! re-read the pages that still hold candidates and keep the ones that
+        pass filter. Returns false if it was cancelled, the pages it didn't
+        get to keep their candidates */
+    bool filter_diff_scan(DiffScan *scan, int filter, qint32 value = 0);
     QByteArray get_data(const VIRTADDR &addr, int size);
     QString pprint(const VIRTADDR &addr, int size);
     QString pprint(const QByteArray &ba, const VIRTADDR &start_addr=0);
@@ -88,8 +144,15 @@ public:
     // Methods for when we know how the data is layed out
     MemoryLayout *memory_layout() {return m_layout;}
     void read_raws();
-    QVector<Dwarf*> load_dwarves();
+    /*! dwarves found in reusable at the same address whose memory hasn't
+        changed since the last pass are handed back as-is instead of being
+        re-read; whatever is left in reusable afterwards is the caller's to
+        delete */
+    QVector<Dwarf*> load_dwarves(QHash<VIRTADDR, Dwarf*> *reusable = 0);
     QVector<Squad*> load_squads();
+    /*! dump every region in m_regions plus the active layout's checksum to
+        filename, which DFInstanceSnapshot can replay without DF running */
+    bool save_snapshot(const QString &filename);
 
     // Set layout
     void set_memory_layout(MemoryLayout * layout) { m_layout = layout; }
@@ -100,12 +163,73 @@ public:
     virtual int write_string(const VIRTADDR &addr, const QString &str) = 0;
     virtual int write_int(const VIRTADDR &addr, const int &val) = 0;
 
+    /*! Write plans collect writes (say, from every dirty dwarf) so that
+        commit_writes() can coalesce them and apply them in one stop window.
+        Later writes to the same bytes win. */
+    void queue_write(const VIRTADDR &addr, const QByteArray &data);
+    bool has_queued_writes() {return !m_queued_writes.isEmpty();}
+    void discard_writes() {m_queued_writes.clear();}
+    /*! apply everything queued, then read it back. Returns true if every
+        byte landed; otherwise whatever was written is put back the way it
+        was and the plan is kept so the caller can report or retry. */
+    bool commit_writes();
+
     bool add_new_layout(const QString & version, QFile & file);
     void layout_not_found(const QString & checksum);
 
     bool is_attached() {return m_attach_count > 0;}
     virtual bool attach() = 0;
     virtual bool detach() = 0;
+    /*! true if attaching holds DF in a way only one instance can at a time
+        (a ptrace stop), so a second instance mustn't read alongside */
+    virtual bool exclusive_attach() {return false;}
+    //! our segment table looks stale, remap before the next read session
+    void request_remap() {m_remap_pending = true;}
+
+    /*! Page cache for remote reads. Pages are only kept while we're
+        attached (DF is stopped and can't change them under us) and only
+        for the current read generation, so start a new generation at the
+        top of each read pass. Detaching drops the cache. */
+    void new_read_generation();
+    void drop_read_cache();
+    int read_generation() {return m_read_generation;}
+    quint64 cache_hits() {return m_cache_hits;}
+    quint64 cache_misses() {return m_cache_misses;}
+
+    /*! A read session holds DF stopped for a whole read pass (creatures,
+        squads, translations...) so every read in between shares a single
+        attach. Sessions nest; only the outermost one attaches, starts a
+        new read generation and times how long DF was held. Prefer the
+        DFReadSession guard below over calling these directly. */
+    void begin_read_session();
+    void end_read_session();
+    bool in_read_session() {return m_session_depth > 0;}
+    //! how long (ms) DF was stopped by the last completed session
+    int last_session_msecs() {return m_last_session_msecs;}
+
+    //! true if we read while DF keeps running instead of stopping it
+    bool live_reads() {return m_live_reads;}
+    quint64 torn_reads() {return m_torn_reads;}
+
+    /*! Change tracking lets a refresh skip structures DF hasn't written to.
+        start_change_tracking() marks every page of DF's as clean, after
+        which pages_changed() tells if any of the given pages has been
+        written since. Platforms that can't tell report everything as
+        changed. */
+    virtual bool start_change_tracking() {return false;}
+    virtual bool pages_changed(const QVector<VIRTADDR> &pages) {
+        Q_UNUSED(pages);
+        return true;
+    }
+
+    /*! scans only look at segments of these MemorySegment::SEGMENT_TYPEs,
+        by default everything but shared libraries and stacks. Pass
+        MemorySegment::SEG_ALL to search every mapped region again */
+    void set_scan_scope(int segment_types) {m_scan_scope = segment_types;}
+    int scan_scope() {return m_scan_scope;}
+    /*! a reader for one scan worker thread, the caller owns it. The default
+        funnels every worker through read_remote() one at a time */
+    virtual ScanReader *new_scan_reader();
 
     static bool authorize();
 
@@ -118,28 +242,64 @@ public:
     static const int STRING_CAP_OFFSET = 20;    // Relative to STRING_BUFFER_OFFSET
     static const int VECTOR_POINTER_OFFSET = 4;
 #endif
+    // libstdc++ strings point at their characters, the length and capacity
+    // live in front of them (relative to the character data)
 #ifdef Q_WS_X11
     static const int STRING_BUFFER_OFFSET = 0;
-    static const int STRING_LENGTH_OFFSET = 0; // Dummy value
-    static const int STRING_CAP_OFFSET = 0;    // Dummy value
+    static const int STRING_LENGTH_OFFSET = -12;
+    static const int STRING_CAP_OFFSET = -8;
     static const int VECTOR_POINTER_OFFSET = 0;
 #endif
 #ifdef Q_WS_MAC
     static const int STRING_BUFFER_OFFSET = 0;
-    static const int STRING_LENGTH_OFFSET = 0; // Dummy value
-    static const int STRING_CAP_OFFSET = 0;    // Dummy value
+    static const int STRING_LENGTH_OFFSET = -12;
+    static const int STRING_CAP_OFFSET = -8;
     static const int VECTOR_POINTER_OFFSET = 0;
 #endif
 
     // handy util methods
     virtual quint32 calculate_checksum() = 0;
     MemoryLayout *get_memory_layout(QString checksum, bool warn = true);
+    /*! start watching DF for exits, unloads and creature changes, if the
+        user wants to hear about them. Only for the main window's instance,
+        each beat is a read (a stop, on Linux) */
+    void start_heartbeat();
 
     public slots:
         // if a menu cancels our scan, we need to know how to stop
         void cancel_scan() {m_stop_scan = true;}
 
 protected:
+    static const int CACHE_PAGE_SIZE = 0x1000;
+    static const int MAX_CACHED_READ = 4 * CACHE_PAGE_SIZE; // bigger reads skip the cache
+    static const int MAX_TORN_RETRIES = 4;
+    // the heartbeat backs off between these while nothing changes
+    static const int HEARTBEAT_MIN_MSECS = 1000;
+    static const int HEARTBEAT_MAX_MSECS = 8000;
+
+    // uncached access to DF's memory, what the platforms implement
+    virtual int read_remote(const VIRTADDR &addr, int bytes, void *buffer);
+    virtual int read_remote_batch(QVector<ReadRequest> &requests);
+    //! write every range, filling in bytes_read with what was written
+    virtual int write_remote_batch(QVector<ReadRequest> &writes);
+    void invalidate_cached_range(const VIRTADDR &addr, int bytes);
+
+    // std::string readers for the two runtimes DF has been built with
+    static const int MAX_STRING_LENGTH = 1024;
+    // extents, if given, gets what read_tracked_string() reports
+    QString read_msvc_string(const VIRTADDR &addr,
+                             QVector<ReadRequest> *extents = 0);
+    QString read_libstdcxx_string(const VIRTADDR &addr,
+                                  QVector<ReadRequest> *extents = 0);
+    //! decode CP437 bytes, handing back a shared copy of strings we've seen
+    QString pooled_string(const QByteArray &raw);
+    //! rebuild the sorted range table from m_regions, call after mapping
+    void build_address_index();
+    bool in_scan_scope(const MemorySegment *seg);
+    /*! one bit per page in [start, end), cleared for pages DF has never
+        touched (which read back as zeros) so scans can skip them. The
+        default says every page is there */
+    virtual QBitArray resident_pages(const VIRTADDR &start, const VIRTADDR &end);
 
     int m_pid;
     VIRTADDR m_base_addr;
@@ -147,17 +307,40 @@ protected:
     VIRTADDR m_lowest_address;
     VIRTADDR m_highest_address;
     VIRTADDR m_heap_start_address;
-    bool m_stop_scan; // flag that gets set to stop scan loops
+    /*! flag that gets set to stop scan loops, atomic since cancel_scan()
+        is called straight from the GUI thread while a job thread scans */
+    QAtomicInt m_stop_scan;
     bool m_is_ok;
     int m_bytes_scanned;
     MemoryLayout *m_layout;
     QVector<MemorySegment*> m_regions;
+    // m_regions flattened into sorted, merged [start, end] ranges so address
+    // checks are a binary search instead of a walk over every segment
+    QVector<VIRTADDR> m_range_starts;
+    QVector<VIRTADDR> m_range_ends;
+    int m_last_range_hit;
+    bool m_remap_pending;
     int m_attach_count;
     QTimer *m_heartbeat_timer;
+    QByteArray m_heartbeat_fingerprint; // what the last heartbeat saw
+    int m_scan_scope; // MemorySegment::SEGMENT_TYPE flags
     QTimer *m_memory_remap_timer;
     QTimer *m_scan_speed_timer;
     WORD m_dwarf_race_id;
     QDir m_df_dir;
+    QHash<QByteArray, QString> m_string_pool; // raw bytes->decoded string
+    QList<QPair<VIRTADDR, QByteArray> > m_queued_writes; // in queue order
+    QCache<VIRTADDR, QByteArray> m_page_cache; // page address->page data
+    bool m_cache_enabled;
+    int m_read_generation;
+    quint64 m_cache_hits;
+    quint64 m_cache_misses;
+    int m_session_depth;
+    QTime m_session_timer;
+    int m_last_session_msecs;
+    bool m_live_reads;
+    quint64 m_torn_reads;
+    PointerIndex *m_pointer_index;
 
     /*! this hash will hold a map of all loaded and valid memory layouts found
         on disk, the key is a QString of the checksum since other OSs will use
@@ -169,16 +352,44 @@ protected:
         void calculate_scan_rate();
         virtual void map_virtual_memory() = 0;
 
+private:
+    friend class LockedScanReader;
+    QMutex m_scan_read_lock; // for LockedScanReader
+    /*! scan every in-scope segment between start_addr and end_addr with
+        kernel on worker threads, returning the sorted hits */
+    QVector<VIRTADDR> run_scan(ScanKernel *kernel, const uint start_addr=0,
+                               const uint end_addr=0xffffffff);
+    //! run kernel over whatever was queued on engine, for run_scan()
+    QVector<VIRTADDR> run_engine(ScanEngine *engine, ScanKernel *kernel);
+    bool caching() {return m_cache_enabled && is_attached() && !m_live_reads;}
+    QByteArray *cached_page(const VIRTADDR &page);
+    int read_cached(const VIRTADDR &addr, int bytes, char *out);
+
 signals:
     // methods for sending progress information to QWidgets
     void scan_total_steps(int steps);
     void scan_progress(int step);
     void scan_message(const QString &message);
-    void connection_interrupted();
+    // heartbeat results: DF exited, the fort was unloaded, or creatures
+    // came or went since the last beat
+    void process_gone();
+    void fort_unloaded();
+    void creatures_changed();
     void progress_message(const QString &message);
     void progress_range(int min, int max);
     void progress_value(int value);
+    void read_session_finished(int msecs);
 
 };
 
+//! keeps DF stopped for as long as this is in scope
+class DFReadSession {
+public:
+    DFReadSession(DFInstance *df) : m_df(df) {m_df->begin_read_session();}
+    ~DFReadSession() {m_df->end_read_session();}
+private:
+    DFInstance *m_df;
+    Q_DISABLE_COPY(DFReadSession)
+};
+
 #endif // DFINSTANCE_H
@@ -49,12 +49,45 @@ public:
 
     bool attach();
     bool detach();
+    bool exclusive_attach() {return !m_live_reads;}
 
 
 protected:
     uint calculate_checksum();
+    int read_remote(const VIRTADDR &addr, int bytes, void *buffer);
+    int read_remote_batch(QVector<ReadRequest> &requests);
+    int write_remote_batch(QVector<ReadRequest> &writes);
+public:
+    // soft-dirty bits from /proc/<pid>/clear_refs and /proc/<pid>/pagemap
+    bool start_change_tracking();
+    bool pages_changed(const QVector<VIRTADDR> &pages);
+    ScanReader *new_scan_reader();
+protected:
+    QBitArray resident_pages(const VIRTADDR &start, const VIRTADDR &end);
 private:
+    //! /proc/<pid>/mem, held open for as long as we're connected
     QFile m_memory_file;
+    //! the same file opened for writing, which only some kernels allow
+    QFile m_memory_write_file;
+    bool m_use_vm_readv; // cleared if the kernel won't do process_vm_readv
+    bool m_use_vm_writev; // likewise for process_vm_writev
+    bool m_use_mem_pwrite; // cleared once writing /proc/<pid>/mem fails
+    QFile m_pagemap_file;
+    bool m_soft_dirty_ok; // cleared if the kernel can't track soft-dirty pages
+    bool m_tracking_changes; // soft-dirty bits were cleared after a full pass
+    bool open_memory_file();
+    bool open_pagemap_file();
+    //! every running DF we could attach to, found by walking /proc
+    static QList<int> find_df_pids();
+    static uint checksum_of(int pid);
+    //! pick which DF to connect to when there's more than one
+    int choose_df_pid(const QList<int> &pids);
+    static int s_chosen_pid; // remembered so scanner jobs follow the user's pick
+    //! write a range one word at a time with POKEDATA, DF must be stopped
+    int poke_words(const VIRTADDR &addr, int bytes, const char *buffer);
+    // the actual ptrace stop/resume; attach()/detach() skip these for live reads
+    bool stop_process();
+    void resume_process();
 };
 
 #endif // DFINSTANCE_H
@@ -0,0 +1,94 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef DFINSTANCE_SNAPSHOT_H
+#define DFINSTANCE_SNAPSHOT_H
+#include "dfinstance.h"
+
+class MemoryLayout;
+
+/*! Serves DF's memory out of a snapshot file written by
+    DFInstance::save_snapshot() instead of a running process. The file is
+    memory-mapped, so reads are a memcpy. Snapshots can only be replayed on
+    the platform they were captured on, since that's where the matching
+    memory layouts live. Everything is read-only. */
+class DFInstanceSnapshot : public DFInstance {
+    Q_OBJECT
+public:
+    DFInstanceSnapshot(const QString &filename, QObject *parent=0);
+    virtual ~DFInstanceSnapshot();
+
+    QString filename() const {return m_file.fileName();}
+
+    // factory ctor, loads the snapshot file
+    bool find_running_copy(bool connect_anyway = false);
+    QVector<VIRTADDR> enumerate_vector(const VIRTADDR &addr);
+    int read_raw(const VIRTADDR &addr, int bytes, QByteArray &buffer);
+    QString read_string(const VIRTADDR &addr);
+
+    // Writing, which a snapshot doesn't do
+    int write_raw(const VIRTADDR &addr, const int &bytes, void *buffer);
+    int write_string(const VIRTADDR &addr, const QString &str);
+    int write_int(const VIRTADDR &addr, const int &val);
+
+    void map_virtual_memory();
+
+    bool attach();
+    bool detach();
+    ScanReader *new_scan_reader();
+
+    // file format, shared with DFInstance::save_snapshot()
+    static const char *MAGIC; // 8 bytes
+    static const quint32 FORMAT_VERSION = 2; // 1 had no segment types
+    static const int HEADER_SIZE = 48;
+    static const int SEGMENT_SIZE = 20; // start, end, flags, 64bit offset
+    static const quint32 SEGMENT_HEAP = 0x1;
+    //! flags bits 8-15 hold the MemorySegment::SEGMENT_TYPE
+    static const int SEGMENT_TYPE_SHIFT = 8;
+    static const int DATA_ALIGNMENT = 0x1000;
+    //! which DFInstance flavor wrote a snapshot, they don't mix
+    static quint32 platform_id();
+
+protected:
+    quint32 calculate_checksum();
+    int read_remote(const VIRTADDR &addr, int bytes, void *buffer);
+
+private:
+    friend class SnapshotScanReader;
+    struct Segment {
+        VIRTADDR start_addr;
+        VIRTADDR end_addr;
+        const uchar *data;
+        bool operator<(const Segment &other) const {
+            return start_addr < other.start_addr;
+        }
+    };
+    QFile m_file;
+    uchar *m_map;
+    QString m_checksum;
+    QVector<Segment> m_segments; // sorted by start_addr
+
+    bool load();
+    const Segment *segment_for(const VIRTADDR &addr);
+};
+
+#endif // DFINSTANCE_SNAPSHOT_H
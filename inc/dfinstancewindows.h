@@ -55,6 +55,7 @@ public:
     // make them no-ops
     bool attach(){return true;}
     bool detach(){return true;}
+    ScanReader *new_scan_reader();
 
 
 protected:
@@ -0,0 +1,121 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef DIFF_SCAN_H
+#define DIFF_SCAN_H
+
+#include <QtCore>
+#include "utils.h"
+#include "scanengine.h"
+
+/*! Candidates for a "find the value that changed" search. Every aligned
+    value in the scanned segments starts out as a candidate, each pass
+    re-reads the pages that still hold any and keeps the values that pass
+    a filter (changed, went up, equals N...).
+
+    Candidates are one bit per value slot in a bitmap per 4K page, along
+    with the page as it was read last time for comparing against. Pages
+    that run out of candidates are dropped, so after a couple of passes
+    only a handful are left to re-read. */
+class DiffScan {
+public:
+    typedef enum {
+        CHANGED,
+        UNCHANGED,
+        INCREASED,
+        DECREASED,
+        EQUALS
+    } FILTER;
+
+    static const int PAGE_SIZE = 0x1000;
+
+    //! value_size is 1, 2 or 4 bytes, values are compared as signed
+    explicit DiffScan(int value_size = 4);
+
+    int value_size() const {return m_value_size;}
+    //! true once the first pass has been taken
+    bool started() const {return m_started;}
+    quint64 candidate_count() const {return m_candidates;}
+    int page_count() const {return m_pages.size();}
+    /*! up to max candidates with their value as of the last pass, starting
+        with candidate number first */
+    QList<QPair<VIRTADDR, qint32> > candidates(int max, quint64 first = 0) const;
+    //! every candidate and its value, in address order
+    void all_candidates(QVector<VIRTADDR> &addrs, QVector<qint32> &values) const;
+    /*! start over from candidates saved earlier (see ScanSession), addrs
+        has to be sorted. Only the candidates' own values are known, so
+        the rest of each page reads as zero */
+    void restore(const QVector<VIRTADDR> &addrs, const QVector<qint32> &values);
+    //! forget every candidate
+    void reset();
+
+    /*! runs of contiguous pages that still have candidates, [start, end)
+        pairs to queue for the next pass */
+    QVector<QPair<VIRTADDR, VIRTADDR> > page_runs() const;
+    //! sort what the first pass collected, drop empty pages and recount
+    void finish_pass();
+
+private:
+    struct Page {
+        VIRTADDR addr;
+        QByteArray data; // as of the last pass
+        QBitArray live; // one bit per value slot
+        bool operator<(const Page &rhs) const {return addr < rhs.addr;}
+    };
+    friend class DiffKernel;
+
+    int m_value_size;
+    bool m_started;
+    quint64 m_candidates;
+    QVector<Page> m_pages; // sorted by addr once a pass is done
+    QMutex m_lock; // the first pass adds pages from every worker
+
+    static qint32 value_at(const char *data, int size);
+};
+
+/*! One pass of a DiffScan. The first pass (no filter) copies every page it
+    sees into the scan, later ones only look at pages it already holds and
+    clear the candidates that fail the filter. Each page is only ever in
+    one chunk, so workers never touch the same page. Reports no hits. */
+class DiffKernel : public ScanKernel {
+public:
+    //! the first pass
+    explicit DiffKernel(DiffScan *scan);
+    DiffKernel(DiffScan *scan, DiffScan::FILTER filter, qint32 value);
+
+    int overlap() const {return 0;}
+    void scan(const VIRTADDR &addr, const char *data, int chunk_bytes,
+              int bytes, QVector<VIRTADDR> &hits) const;
+
+private:
+    DiffScan *m_scan;
+    bool m_first_pass;
+    DiffScan::FILTER m_filter;
+    qint32 m_value;
+    DiffScan::Page *m_pages; // taken before the workers start
+    int m_page_count;
+
+    DiffScan::Page *find_page(const VIRTADDR &addr) const;
+    bool passes(qint32 old_val, qint32 new_val) const;
+};
+
+#endif // DIFF_SCAN_H
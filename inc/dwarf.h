@@ -186,6 +186,9 @@ public:
     //! convenience method that calls set_labor() and switches the state of the labor specified by labor_id
     bool toggle_labor(int labor_id);
 
+    //! true if DF hasn't touched any memory this dwarf was read from since the last pass
+    bool is_unchanged();
+
     //! undo any uncomitted changes to this dwarf (reset back to game-state)
     void clear_pending();
 
@@ -218,7 +221,7 @@ public:
     QModelIndex m_name_idx;
 
     //! get's a list of QActions that can be activated on this dwarf, suitable for adding to Toolbars or context menus
-    QList<QAction*> get_actions() {return m_actions;}
+    QList<QAction*> get_actions();
 
     //! returns true if this dwarf can have labors specified on it
     Q_INVOKABLE bool can_set_labors() {return m_can_set_labors;}
@@ -292,23 +295,23 @@ private:
     int m_squad_ref_id; //Dwarf reference that appears to be used by squad
     QString m_squad_name; //The name of the squad that the dwarf belongs to (if any)
     uint m_turn_count; // Dwarf turn count from start of fortress (as best we know)
+    QVector<VIRTADDR> m_footprint; // pages our struct, soul and skills live on
+
+    void add_to_footprint(const VIRTADDR &addr, int bytes);
+    QString read_footprint_string(const VIRTADDR &addr);
 
     // these methods read data from raw memory
-    void read_id();
-    void read_caste();
-    void read_race();
+    void read_fields(QByteArray &labors, VIRTADDR &current_job_addr);
     void read_first_name();
     void read_last_name();
     void read_nick_name();
     void read_profession();
-    void read_labors();
+    void read_labors(const QByteArray &buf);
     void read_happiness();
-    void read_current_job();
+    void read_current_job(const VIRTADDR &current_job_addr);
     void read_souls();
     void read_skills();
     void read_traits();
-    void read_squad_ref_id();
-    void read_turn_count();
 
     // utility methods to assist with reading names made up of several words
     // from the language tables
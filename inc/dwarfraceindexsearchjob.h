@@ -76,10 +76,12 @@ public:
             foreach(uint ptr, m_df->scan_mem(QByteArray("A group of"))) {
                 foreach(uint ptr2, m_df->scan_mem(encode(ptr))) {
                     LOGD << "\tPTR" << hex << ptr2 << m_df->read_string(ptr2);
-                    int offset = m_df->get_data(ptr2, 60).indexOf(encode(RACE_INDEX_MAGIC_REFERENCE));
+                    QByteArray data = m_df->get_data(ptr2, 68);
+                    int offset = data.left(60).indexOf(encode(RACE_INDEX_MAGIC_REFERENCE));
                     if (offset != -1) {
                         LOGD << "\tMATCH! offset" << offset << hex << offset;
-                        VIRTADDR idx_addr = m_df->read_addr(ptr2 + offset + 3);
+                        // the address follows the reference, already in data
+                        VIRTADDR idx_addr = MemorySpan<VIRTADDR>(data).at_offset(offset + 3);
                         LOGD << "\tREAD ADDR FROM" << hex << ptr2 + offset << "=" << idx_addr;
                         int idx = m_df->read_int(idx_addr);
                         LOGD << "\t\tRACE VALUE" << idx << "HEX" << hex << idx;
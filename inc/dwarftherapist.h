@@ -42,7 +42,9 @@ class LogManager;
 class DwarfTherapist : public QApplication {
     Q_OBJECT
 public:
-    DwarfTherapist(int &argc, char **argv);
+    /*! headless runs without a display (no main window, options menu or
+        dialogs), for the command line tool */
+    DwarfTherapist(int &argc, char **argv, bool headless = false);
     virtual ~DwarfTherapist(){}
 
     QVector<CustomProfession*> get_custom_professions() {return m_custom_professions;}
@@ -61,6 +63,7 @@ public:
     Word * get_word(const uint & offset) { return m_language.value(offset, NULL); }
     bool labor_cheats_allowed() {return m_allow_labor_cheats;}
     LogManager *get_log_manager() {return m_log_mgr;}
+    bool headless() {return m_headless;}
 
     public slots:
         void add_custom_profession();
@@ -83,6 +86,7 @@ private:
     bool m_reading_settings;
     bool m_allow_labor_cheats;
     LogManager *m_log_mgr;
+    bool m_headless;
 
     void setup_logging();
     void load_translator();
@@ -26,9 +26,11 @@ protected:
     quint32 m_creature_vector;
     quint32 m_squad_vector;
     quint32 m_current_year;
+    int m_word_table_offset;
 
 private slots:
     void report_address(const QString&, const quint32&);
+    void report_offset(const QString&, const int&);
 };
 
 #endif // LAYOUT_CREATOR_H
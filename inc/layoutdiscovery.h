@@ -0,0 +1,96 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef LAYOUT_DISCOVERY_H
+#define LAYOUT_DISCOVERY_H
+
+#include <QtCore>
+#include "scannerjob.h"
+
+class ScannerThread;
+
+/*! Runs a set of scanner jobs as a dependency graph. Every job whose
+    prerequisites are done is started right away, up to
+    MAX_CONCURRENT_STEPS at once (one at a time when the DFInstance can't
+    be read from two at once, see ScannerConnection), and an address one
+    job reports can be handed to a later one. Everything the jobs find is
+    forwarded through found_address() and found_offset() as it comes in.
+
+    Overlapping steps don't share a DFInstance: the second one gets its
+    own from ScannerConnection, which attaches again (or loads the
+    snapshot again), so its page cache and segment table start cold. */
+class LayoutDiscovery : public QObject {
+    Q_OBJECT
+public:
+    /*! each scan already keeps every core busy, a second job just fills
+        in while the other reads or walks vectors */
+    static const int MAX_CONCURRENT_STEPS = 2;
+
+    //! thread_parent owns the scanner threads, like Scanner's do
+    LayoutDiscovery(QObject *thread_parent, QObject *parent = 0);
+
+    /*! run job after everything in after is done. If input names an address
+        an earlier job found, that job's first report is passed to this one
+        as its meta */
+    void add_step(SCANNER_JOB_TYPE job,
+                  const QList<SCANNER_JOB_TYPE> &after = QList<SCANNER_JOB_TYPE>(),
+                  const QString &input = QString());
+    //! runs every step, returning once they're all done or cancelled
+    void run();
+    //! start no more steps, and stop the ones running at their next scan
+    void cancel();
+    //! first address reported under name, 0 if none was
+    quint32 address(const QString &name) const {return m_found.value(name, 0);}
+
+signals:
+    void total_steps(int);
+    void steps_done(int);
+    void scan_message(const QString&);
+    void found_address(const QString&, const quint32&);
+    void found_offset(const QString&, const int&);
+
+private slots:
+    void record_address(const QString &name, const quint32 &addr);
+    void step_finished();
+
+private:
+    struct Step {
+        SCANNER_JOB_TYPE job;
+        QList<SCANNER_JOB_TYPE> after;
+        QString input;
+        ScannerThread *thread;
+        bool done;
+    };
+
+    QObject *m_thread_parent;
+    QList<Step> m_steps;
+    QHash<QString, quint32> m_found; // name->first address reported
+    QEventLoop m_loop;
+    int m_running;
+    int m_done;
+    bool m_cancelled;
+
+    bool is_done(SCANNER_JOB_TYPE job) const;
+    void start_ready_steps();
+};
+
+#endif // LAYOUT_DISCOVERY_H
@@ -63,10 +63,13 @@ public:
     public slots:
         // DF related
         void connect_to_df();
+        void open_snapshot();
+        void capture_snapshot();
         void read_dwarves();
         void scan_memory();
         void new_pending_changes(int);
         void lost_df_connection();
+        void df_creatures_changed();
 
         //settings
         void set_group_by(int);
@@ -135,6 +138,8 @@ private:
 
     void read_settings();
     void write_settings();
+    //! take over df as our connection, replacing any current one
+    void connect_to(DFInstance *df);
 
     private slots:
         void set_interface_enabled(bool);
@@ -2,6 +2,16 @@
 #define MEMORY_SEGMENT_H
 
 struct MemorySegment {
+    //! what a segment holds, so scans can be limited to the interesting ones
+    typedef enum {
+        SEG_EXE = 0x1, // DF's own image, where the globals live
+        SEG_HEAP = 0x2,
+        SEG_ANONYMOUS = 0x4, // unnamed mappings, big allocations end up here
+        SEG_LIBRARY = 0x8,
+        SEG_STACK = 0x10,
+        SEG_ALL = 0xff
+    } SEGMENT_TYPE;
+
     MemorySegment(const QString &_name, const uint &_start_addr, const uint &_end_addr)
         : size(_end_addr - _start_addr)
         , name(_name)
@@ -9,18 +19,25 @@ struct MemorySegment {
         , end_addr(_end_addr)
         , is_heap(false)
         , is_guarded(false)
-
+        , type(SEG_ANONYMOUS)
     {
-        if (name.contains("[heap]"))
+        if (name.contains("[heap]")) {
             is_heap = true;
+            type = SEG_HEAP;
+        } else if (name.startsWith("[stack")) {
+            type = SEG_STACK;
+        } else if (!name.isEmpty()) {
+            type = SEG_LIBRARY; // callers mark DF's own image as SEG_EXE
+        }
     }
     QString to_string() {
-        return QString("0x%1-0x%2 (%L3 bytes) %4 HEAP: %5")
+        return QString("0x%1-0x%2 (%L3 bytes) %4 HEAP: %5 TYPE: %6")
             .arg(start_addr, 8, 16, QChar('0'))
             .arg(end_addr, 8, 16, QChar('0'))
             .arg(size)
             .arg(name)
-            .arg(is_heap);
+            .arg(is_heap)
+            .arg(type);
     }
 
     //! check to see if an address is contained in this memory segment
@@ -34,6 +51,7 @@ struct MemorySegment {
     uint end_addr;
     bool is_heap;
     bool is_guarded; // only used on windows right now
+    int type; // one of SEGMENT_TYPE
 };
 
 #endif
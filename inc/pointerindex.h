@@ -0,0 +1,48 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef POINTER_INDEX_H
+#define POINTER_INDEX_H
+
+#include <QtCore>
+#include "utils.h"
+
+/*! Every pointer found in one sweep over DF's memory, sorted by what it
+    points at, so "who points here?" is a binary search instead of another
+    scan. It's a snapshot: anything DF changed after the sweep isn't in it. */
+class PointerIndex {
+public:
+    /*! takes the (value, address) pairs ValidPointerKernel found, in any
+        order */
+    explicit PointerIndex(const QVector<VIRTADDR> &records);
+
+    int size() const {return m_values.size();}
+    //! sorted addresses of every aligned word holding target
+    QVector<VIRTADDR> pointers_to(const VIRTADDR &target) const;
+
+private:
+    // parallel arrays, sorted by value and then by address
+    QVector<VIRTADDR> m_values;
+    QVector<VIRTADDR> m_addresses;
+};
+
+#endif // POINTER_INDEX_H
@@ -0,0 +1,186 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef SCAN_ENGINE_H
+#define SCAN_ENGINE_H
+
+#include <QtCore>
+#include "utils.h"
+
+/*! Reads DF's memory for one scan worker. Every worker gets its own so
+    platforms can hand each one a separate handle and read without locks.
+    Unreadable bytes come back zeroed. */
+class ScanReader {
+public:
+    virtual ~ScanReader() {}
+    virtual int read(const VIRTADDR &addr, int bytes, char *buffer) = 0;
+};
+
+/*! What a scan looks for. scan() is called from several workers at once, so
+    it mustn't touch anything but its arguments and its own constant state. */
+class ScanKernel {
+public:
+    virtual ~ScanKernel() {}
+    //! how far past the end of a chunk the kernel needs to see
+    virtual int overlap() const = 0;
+    /*! data holds chunk_bytes of the chunk at addr plus up to overlap()
+        bytes after it (bytes in total). Hits must start inside the chunk so
+        neighbouring chunks don't report them twice. */
+    virtual void scan(const VIRTADDR &addr, const char *data, int chunk_bytes,
+                      int bytes, QVector<VIRTADDR> &hits) const = 0;
+    /*! words per hit. Kernels that report more than an address per hit
+        (address, then whatever goes with it) get their hits back in
+        whatever order the chunks were scanned, single word hits come back
+        sorted */
+    virtual int record_words() const {return 1;}
+};
+
+/*! finds every copy of a byte string. Candidates are found by comparing
+    the needle's first and last bytes against 16 or 32 positions at a time
+    (SSE2 or AVX2, whichever the CPU has) before checking the rest */
+class NeedleKernel : public ScanKernel {
+public:
+    typedef void (*SearchFunc)(const char *data, int bytes, int limit,
+                               const QByteArray &needle, const VIRTADDR &addr,
+                               QVector<VIRTADDR> &hits);
+
+    NeedleKernel(const QByteArray &needle);
+    int overlap() const {return qMax(0, m_needle.size() - 1);}
+    void scan(const VIRTADDR &addr, const char *data, int chunk_bytes,
+              int bytes, QVector<VIRTADDR> &hits) const;
+    //! "avx2", "sse2" or "scalar"
+    const char *search_name() const {return m_search_name;}
+private:
+    QByteArray m_needle;
+    SearchFunc m_search;
+    const char *m_search_name;
+};
+
+/*! finds every copy of any of a set of 4-byte values (pointers, mostly) in
+    one pass. Each position is checked against a 64K-bit filter first, only
+    filter hits get the binary search through the sorted targets */
+class PointerSetKernel : public ScanKernel {
+public:
+    PointerSetKernel(const QVector<VIRTADDR> &targets);
+    int overlap() const {return sizeof(VIRTADDR) - 1;}
+    void scan(const VIRTADDR &addr, const char *data, int chunk_bytes,
+              int bytes, QVector<VIRTADDR> &hits) const;
+private:
+    QVector<VIRTADDR> m_targets; // sorted, unique
+    QBitArray m_filter;
+    static uint filter_slot(const VIRTADDR &val) {
+        return (val ^ (val >> 16)) & 0xffff;
+    }
+};
+
+/*! finds words that look like the begin/end pointers of a vector holding
+    between min_entries and max_entries entries. These are only candidates,
+    the caller still has to enumerate them. */
+class VectorKernel : public ScanKernel {
+public:
+    VectorKernel(int min_entries, int max_entries, int entry_size,
+                 int pointer_offset)
+        : m_min_entries(min_entries)
+        , m_max_entries(max_entries)
+        , m_entry_size(entry_size)
+        , m_pointer_offset(pointer_offset)
+    {}
+    int overlap() const {return m_entry_size;}
+    void scan(const VIRTADDR &addr, const char *data, int chunk_bytes,
+              int bytes, QVector<VIRTADDR> &hits) const;
+private:
+    int m_min_entries;
+    int m_max_entries;
+    int m_entry_size;
+    int m_pointer_offset;
+};
+
+/*! finds every aligned word that points into one of DF's segments. Each
+    hit is a (value, address) pair, which is what PointerIndex is built
+    from */
+class ValidPointerKernel : public ScanKernel {
+public:
+    //! starts and ends are DFInstance's sorted [start, end] address ranges
+    ValidPointerKernel(const QVector<VIRTADDR> &starts,
+                       const QVector<VIRTADDR> &ends)
+        : m_starts(starts)
+        , m_ends(ends)
+    {}
+    int overlap() const {return sizeof(VIRTADDR) - 1;}
+    void scan(const VIRTADDR &addr, const char *data, int chunk_bytes,
+              int bytes, QVector<VIRTADDR> &hits) const;
+    int record_words() const {return 2;}
+private:
+    QVector<VIRTADDR> m_starts;
+    QVector<VIRTADDR> m_ends;
+};
+
+/*! Splits ranges of DF's memory into page-aligned chunks and scans them on
+    a pool of worker threads. Workers claim chunks off a shared cursor, so
+    whoever finishes early just takes more and the slow chunks don't hold
+    everyone up. Progress is kept in atomic counters for the caller to
+    sample while it waits. */
+class ScanEngine {
+public:
+    static const int CHUNK_SIZE = 0x40000;
+
+    ScanEngine();
+    ~ScanEngine();
+
+    /*! queue [start, end) for scanning, reads may run on up to limit for a
+        kernel's overlap */
+    void add_range(const VIRTADDR &start, const VIRTADDR &end,
+                   const VIRTADDR &limit);
+    qint64 total_bytes() const {return m_total_bytes;}
+    qint64 bytes_scanned() const {return (qint64)m_kb_scanned * 1024;}
+    int worker_count() const {return m_worker_count;}
+
+    //! takes ownership of readers, one worker is started per reader
+    void start(ScanKernel *kernel, const QList<ScanReader*> &readers);
+    //! true once every worker is done, waiting at most msecs
+    bool wait(int msecs);
+    void cancel() {m_cancelled = 1;}
+    /*! every hit once wait() returned true, sorted unless the kernel's
+        hits are more than one word */
+    QVector<VIRTADDR> results();
+
+private:
+    struct Chunk {
+        VIRTADDR addr;
+        int bytes;
+        VIRTADDR limit; // end of the segment, overlap reads stop here
+    };
+    class Worker;
+    friend class Worker;
+
+    QVector<Chunk> m_chunks;
+    qint64 m_total_bytes;
+    ScanKernel *m_kernel;
+    QList<Worker*> m_workers;
+    int m_worker_count;
+    QSemaphore m_finished;
+    QAtomicInt m_next_chunk;
+    QAtomicInt m_kb_scanned;
+    QAtomicInt m_cancelled;
+};
+
+#endif // SCAN_ENGINE_H
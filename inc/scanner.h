@@ -29,12 +29,15 @@ THE SOFTWARE.
 
 class DFInstance;
 class ScannerThread;
+class LayoutDiscovery;
+class DiffScan;
+class ScanSession;
 
 class Scanner: public QDialog {
     Q_OBJECT
 public:
     Scanner(DFInstance *df, MainWindow *parent = 0);
-    virtual ~Scanner(){}
+    virtual ~Scanner();
 
     public slots:
         void report_address(const QString&, const quint32&);
@@ -42,16 +45,43 @@ public:
         void cancel_scan();
 
 private:
+    // hit lists that can be paged through and saved, same order as
+    // cb_session_target
+    typedef enum {
+        VECTOR_HITS,
+        NARROWING_HITS,
+        DIFF_HITS,
+        RESULT_SETS
+    } RESULT_SET;
+    static const int PAGE_ROWS = 200; // printing more than this hangs the UI
+
     DFInstance *m_df;
     ScannerThread *m_thread;
+    LayoutDiscovery *m_discovery; // while creating a layout
     Ui::ScannerDialog *ui;
     bool m_stop_scanning;
 
+    QVector<VIRTADDR> m_vectors; // from the last search by length
+    QString m_vectors_search;
     QVector<VIRTADDR> m_narrow;
+    QStringList m_narrow_steps; // entry counts narrowed by so far
+    DiffScan *m_diff; // candidates of the differential search
+    QStringList m_diff_steps; // filters applied so far
+    quint64 m_next_row[RESULT_SETS]; // where printing each set left off
 
     void set_ui_enabled(bool enabled);
     void prepare_new_thread(SCANNER_JOB_TYPE type);
-    void run_thread_and_wait();
+    //! result gets the vector of addresses the job handed back, if any
+    void run_thread_and_wait(QVector<VIRTADDR> *result = 0);
+
+    quint64 result_count(RESULT_SET set) const;
+    //! the next PAGE_ROWS hits of set, starting over once all were shown
+    void print_page(RESULT_SET set);
+    QString layout_checksum();
+    ScanSession session_for(RESULT_SET set);
+    //! false, after telling the user why, if session can't replace set
+    bool apply_session(RESULT_SET set, const ScanSession &session);
+    void load_session(bool intersect);
 
     void get_brute_force_address_range(uint &start_addr, uint &end_addr);
 
@@ -77,5 +107,14 @@ private:
         void change_operator();
         void find_current_year();
 
+        void start_diff_scan();
+        void filter_diff_scan();
+        void print_diff_scan();
+
+        void print_session();
+        void save_session();
+        void resume_session();
+        void intersect_session();
+
 };
 #endif
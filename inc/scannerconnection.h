@@ -0,0 +1,81 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef SCANNER_CONNECTION_H
+#define SCANNER_CONNECTION_H
+
+#include <QtCore>
+
+class DFInstance;
+class MemoryLayout;
+
+/*! One DFInstance shared by every scanner job, so a chain of jobs (like the
+    layout creator runs) loads the layouts, checksums DF and maps its memory
+    once instead of once per job. Jobs still get their own read handles
+    from DFInstance::new_scan_reader() for each scan.
+
+    DFInstance owns timers, so it has to live in the thread using it. The
+    GUI thread lends it to a scanner thread before starting it, the job
+    borrows it from there and gives it back to the GUI thread when done.
+    Jobs running while it's lent out get a private instance. */
+class ScannerConnection {
+public:
+    /*! share an instance that's already connected (a snapshot, say) from
+        the GUI thread, instead of connecting on the first borrow. It's
+        deleted by close() */
+    static void adopt(DFInstance *df);
+    /*! jobs replay this memory snapshot instead of connecting to a running
+        DF, an empty filename goes back to live. Call from the GUI thread */
+    static void use_snapshot(const QString &filename);
+    /*! call from the GUI thread before starting thread. Does nothing if
+        another thread has it */
+    static void lend_to(QThread *thread);
+    /*! the shared instance if it was lent to this thread, connecting the
+        first time. Otherwise a private instance, like jobs used to get.
+        ok says whether DF was found */
+    static DFInstance *borrow(bool *ok);
+    //! from the borrowing thread, private instances are deleted
+    static void give_back(DFInstance *df);
+    /*! true if a job borrowing now could run next to the one holding the
+        shared instance. Not when attaching stops DF for one instance only
+        (ptrace). Unknown until the first connect, so false then too */
+    static bool allows_concurrent_jobs();
+    //! stop whatever scans the borrowed instances are running
+    static void cancel_scan();
+    //! drop the shared instance, e.g. once the scanner closes
+    static void close();
+
+private:
+    static QMutex m_lock;
+    static DFInstance *m_df;
+    static MemoryLayout *m_layout; // what the connect picked
+    static bool m_connected;
+    static bool m_lent;
+    static QString m_snapshot; // what jobs replay, empty for a live DF
+
+    //! a fresh, unconnected instance of the kind jobs should use
+    static DFInstance *new_instance();
+    static QPointer<QThread> m_holder; // the thread it was lent to
+    static QList<DFInstance*> m_private; // handed out while it was lent
+};
+
+#endif // SCANNER_CONNECTION_H
@@ -79,7 +79,12 @@ public:
                 m_job = new DwarfRaceIndexSearchJob;
                 break;
             case FIND_CREATURE_VECTOR:
-                m_job = new CreatureVectorSearchJob;
+                {
+                    CreatureVectorSearchJob *job = new CreatureVectorSearchJob;
+                    if (m_meta.size() == sizeof(VIRTADDR))
+                        job->set_dwarf_race_index(decode_dword(m_meta));
+                    m_job = job;
+                }
                 break;
             case FIND_POSITION_VECTOR:
                 m_job = new PositionVectorSearchJob;
@@ -154,7 +159,10 @@ public:
         connect(m_job, SIGNAL(got_result(void *)), this, SLOT(set_result(void *)));
         QTimer::singleShot(0, m_job, SLOT(go()));
         exec();
-        m_job->deleteLater();
+        // right away rather than later, so the job hands its DFInstance back
+        // from this thread
+        delete m_job;
+        m_job = 0;
     }
 
 private:
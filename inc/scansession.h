@@ -0,0 +1,78 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef SCAN_SESSION_H
+#define SCAN_SESSION_H
+
+#include <QtCore>
+#include "utils.h"
+
+/*! The result of a long search (vector sweeps, narrowing, differential
+    filters) kept on disk so it can be picked up again after the scanner
+    closes or DF restarts, or combined with a session from another run.
+
+    Addresses are stored corrected (as if DF's image was loaded at its
+    preferred base), sorted, and delta encoded, along with the value each
+    one had when the session came from a differential search. The layout
+    checksum says which DF version the addresses belong to. */
+class ScanSession {
+public:
+    static const char *MAGIC; // 8 bytes
+    static const quint32 FORMAT_VERSION = 1;
+    static const quint32 HAS_VALUES = 0x1;
+
+    //! kind is what produced the hits, e.g. "narrowing"
+    explicit ScanSession(const QString &kind = QString());
+
+    QString kind() const {return m_kind;}
+    QString checksum() const {return m_checksum;}
+    void set_checksum(const QString &checksum) {m_checksum = checksum;}
+    QString param(const QString &key) const {return m_params.value(key);}
+    void set_param(const QString &key, const QString &value);
+    const QMap<QString, QString> &params() const {return m_params;}
+
+    int size() const {return m_addrs.size();}
+    bool has_values() const {return !m_values.isEmpty();}
+    //! the hits as they are in a DF with this memory correction
+    QVector<VIRTADDR> addresses(quint32 memory_correction) const;
+    //! parallel to addresses(), empty unless the hits came with values
+    const QVector<qint32> &values() const {return m_values;}
+    /*! replaces the hits, values is either empty or parallel to addrs.
+        Neither has to be sorted */
+    void set_hits(const QVector<VIRTADDR> &addrs, quint32 memory_correction,
+                  const QVector<qint32> &values = QVector<qint32>());
+
+    //! keep only the hits other has too, along with their values here
+    void intersect(const ScanSession &other);
+
+    bool save(const QString &filename) const;
+    bool load(const QString &filename);
+
+private:
+    QString m_kind;
+    QString m_checksum;
+    QMap<QString, QString> m_params;
+    QVector<VIRTADDR> m_addrs; // corrected and sorted
+    QVector<qint32> m_values;
+};
+
+#endif // SCAN_SESSION_H
@@ -114,10 +114,15 @@ public slots:
         }
 
         //Find the vector entry pointing to this squad
-        emit scan_message(tr("Locating references to this squad"));
+        emit scan_message(tr("Indexing pointers"));
         emit main_scan_progress(2);
+        if (!m_df->build_pointer_index()) {
+            emit quit();
+            return;
+        }
 
-        QVector<VIRTADDR> squad_ref_ptrs = m_df->scan_mem(encode(squad_addr));
+        emit scan_message(tr("Locating references to this squad"));
+        QVector<VIRTADDR> squad_ref_ptrs = m_df->pointers_to(squad_addr);
         if(squad_ref_ptrs.size() != 1) {
             LOGW << "Warning: found no references to the squad";
             if(squad_ref_ptrs.size() == 0) {
@@ -129,7 +134,7 @@ public slots:
         //finally, find the vector that the entry belongs to
         emit scan_message(tr("Locating the squad vector"));
         emit main_scan_progress(3);
-        QVector<VIRTADDR> squad_vectors = m_df->scan_mem(encode(squad_ref_ptrs.front()));
+        QVector<VIRTADDR> squad_vectors = m_df->pointers_to(squad_ref_ptrs.front());
 
         emit main_scan_progress(4);
         foreach(VIRTADDR squad_vec, squad_vectors) {
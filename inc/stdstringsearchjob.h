@@ -71,6 +71,10 @@ public:
 #endif
 
             QVector<VIRTADDR> str_buf_hits = m_df->scan_mem(m_needle);
+            // every pointer to every buffer we found, in one pass
+            QHash<VIRTADDR, QVector<VIRTADDR> > buf_ptrs;
+            if (follow_ptr)
+                buf_ptrs = m_df->scan_pointers(str_buf_hits);
             emit main_scan_total_steps(str_buf_hits.size());
             for(int i = 0; i < str_buf_hits.size(); ++i) {
                 emit main_scan_progress(i);
@@ -79,7 +83,7 @@ public:
                 LOGD << "found buffer at:" << hexify(str_buf);
                 LOGD << "encoded:" << encode(str_buf).toHex();
                 if (follow_ptr) {
-                    foreach (VIRTADDR ptr, m_df->scan_mem(encode(str_buf))) {
+                    foreach (VIRTADDR ptr, buf_ptrs.value(str_buf)) {
                         // found a ptr to the string buffer, so back up to what
                         // should be the start of the std::string object
                         VIRTADDR str_ptr = ptr - m_df->memory_layout()->string_buffer_offset();
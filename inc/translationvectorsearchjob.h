@@ -98,12 +98,17 @@ public slots:
                     dwarf_translation = addr - m_df->VECTOR_POINTER_OFFSET;
                     word_table_offset = dwarf_lang_table - dwarf_translation;
                     emit found_offset("word_table", word_table_offset);
-                    //now find a pointer to this guy...
-                    foreach (uint trans_ptr, m_df->scan_mem(encode(dwarf_translation + m_df->VECTOR_POINTER_OFFSET))) {
-                        foreach (uint trans_vec_ptr, m_df->scan_mem(encode(trans_ptr))) {
+                    //now find a pointer to this guy, and pointers to those
+                    emit scan_message(tr("Indexing pointers"));
+                    if (!m_df->build_pointer_index())
+                        break;
+                    QVector<VIRTADDR> trans_ptrs = m_df->pointers_to(dwarf_translation + m_df->VECTOR_POINTER_OFFSET);
+                    foreach (const QVector<VIRTADDR> &trans_vec_ptrs, m_df->scan_pointers(trans_ptrs)) {
+                        foreach (VIRTADDR trans_vec_ptr, trans_vec_ptrs) {
                             translations_vectors << trans_vec_ptr - m_df->VECTOR_POINTER_OFFSET;
                         }
                     }
+                    qSort(translations_vectors);
                     emit sub_scan_progress(steps);
                     break;
                 }
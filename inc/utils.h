@@ -25,7 +25,9 @@ THE SOFTWARE.
 
 #include <QByteArray>
 #include <QColor>
+#include <QVector>
 #include <QtGlobal>
+#include <string.h>
 
 // valid for as long as DF stays 32bit
 typedef quint32 VIRTADDR;
@@ -86,6 +88,66 @@ static inline short decode_short(const QByteArray &arr) {
     return *out_ptr;
 }
 
+/*! Decodes values of type T straight out of a read buffer without copying
+    it into temporaries. Entries are stride bytes apart, which defaults to
+    sizeof(T) for packed arrays like a vector's pointer block. Anything that
+    would run past the end of the buffer decodes as 0. */
+template <typename T>
+class MemorySpan {
+public:
+    MemorySpan(const char *data, int bytes, int stride = sizeof(T))
+        : m_data(data)
+        , m_bytes(bytes)
+        , m_stride(stride)
+    {}
+    MemorySpan(const QByteArray &buf, int stride = sizeof(T))
+        : m_data(buf.constData())
+        , m_bytes(buf.size())
+        , m_stride(stride)
+    {}
+
+    //! number of whole entries in the buffer
+    int size() const {
+        if (m_bytes < (int)sizeof(T))
+            return 0;
+        return (m_bytes - (int)sizeof(T)) / m_stride + 1;
+    }
+    T at(int i) const {return at_offset(i * m_stride);}
+    T operator[](int i) const {return at(i);}
+
+    //! the T that starts offset bytes into the buffer
+    T at_offset(int offset) const {
+        T val = 0;
+        if (offset >= 0 && offset + (int)sizeof(T) <= m_bytes)
+            memcpy(&val, m_data + offset, sizeof(T));
+        return val;
+    }
+
+    //! append every entry to out, growing it once up front
+    void append_to(QVector<T> &out) const {
+        int count = size();
+        int old_size = out.size();
+        out.resize(old_size + count);
+        if (m_stride == (int)sizeof(T)) {
+            memcpy(out.data() + old_size, m_data, count * sizeof(T));
+        } else {
+            T *dst = out.data() + old_size;
+            for (int i = 0; i < count; ++i)
+                dst[i] = at(i);
+        }
+    }
+    QVector<T> to_vector() const {
+        QVector<T> out;
+        append_to(out);
+        return out;
+    }
+
+private:
+    const char *m_data;
+    int m_bytes;
+    int m_stride;
+};
+
 static inline QByteArray encode_skillpattern(short skill, short exp, short rating) {
     QByteArray bytes;
     bytes.reserve(6);
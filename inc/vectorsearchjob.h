@@ -67,18 +67,9 @@ public:
                                          params->op, params->start_addr, params->end_addr);
             LOGD << "Search complete, found " << vectors.size() << " vectors.";
 
-            //Only report the first 200 or so vectors, otherwise the UI hangs
-            int count = 0;
-            foreach(uint addr, vectors) {
-                if(count < 200) {
-                    emit found_address("vector found at", addr);
-                } else {
-                    VIRTADDR corrected_addr = addr - m_df->get_memory_correction();
-                    LOGD << "Extra vector address found:"
-                            << hexify(corrected_addr) << "uncorrected:" << hexify(addr);
-                }
-                count++;
-            }
+            // handed over whole, the scanner pages through them so the UI
+            // doesn't hang on thousands of hits
+            emit got_result(new QVector<VIRTADDR>(vectors));
             emit quit();
         }
 
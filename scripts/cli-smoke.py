@@ -0,0 +1,48 @@
+#!/usr/bin/python
+"""Smoke run for DwarfTherapistCli (qmake CONFIG+=cli).
+
+usage: cli-smoke.py PATH_TO_CLI SNAPSHOT.dtm [COUNT]
+
+Runs the vectors_of_size job against a memory snapshot and checks it came
+back with a list of vector addresses, then checks a malformed argument is
+refused instead of being handed to the job.
+"""
+import json, subprocess, sys
+
+def run(cli, *args):
+	p = subprocess.Popen([cli] + list(args), stdout=subprocess.PIPE,
+		stderr=subprocess.PIPE)
+	out, err = p.communicate()
+	return p.returncode, out.decode('utf-8', 'replace')
+
+def main():
+	if len(sys.argv) < 3:
+		print(__doc__)
+		return 2
+	cli, snapshot = sys.argv[1], sys.argv[2]
+	count = sys.argv[3] if len(sys.argv) > 3 else '10'
+
+	code, out = run(cli, '--snapshot', snapshot, '--job',
+		'vectors_of_size==%s' % count)
+	if code != 0:
+		print('FAIL: exit code %d' % code)
+		return 1
+	result = json.loads(out)
+	job = result['jobs'][0]
+	if job['job'] != 'vectors_of_size' or not isinstance(job.get('vectors'), list):
+		print('FAIL: no vector list in %s' % job)
+		return 1
+	for addr in job['vectors']:
+		int(addr, 16)
+	print('ok: %d vectors of %s entries in %d ms' % (len(job['vectors']),
+		count, job['msecs']))
+
+	code, out = run(cli, '--snapshot', snapshot, '--job', 'vectors_of_size=?')
+	if code != 2:
+		print('FAIL: malformed argument exited with %d, expected 2' % code)
+		return 1
+	print('ok: malformed argument refused')
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
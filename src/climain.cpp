@@ -0,0 +1,335 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* Headless front end for scripting and benchmarking: connects to DF (or
+   opens a memory snapshot), runs scanner jobs and/or reads the creatures,
+   and prints what it found and how long everything took as JSON. Build it
+   with "qmake CONFIG+=cli". */
+
+#include "dwarftherapist.h"
+#include "dfinstance.h"
+#include "dfinstancesnapshot.h"
+#include "memorylayout.h"
+#include "scannerthread.h"
+#include "scannerconnection.h"
+#include "vectorsearchjob.h"
+#include "dwarf.h"
+#include "utils.h"
+#include "truncatingfilelogger.h"
+
+static const struct {
+    const char *name;
+    SCANNER_JOB_TYPE type;
+} JOB_NAMES[] = {
+    {"translations_vector", FIND_TRANSLATIONS_VECTOR},
+    {"stone_vector", FIND_STONE_VECTOR},
+    {"metal_vector", FIND_METAL_VECTOR},
+    {"std_string", FIND_STD_STRING},
+    {"null_terminated_string", FIND_NULL_TERMINATED_STRING},
+    {"vectors_of_size", FIND_VECTORS_OF_SIZE},
+    {"dwarf_race_index", FIND_DWARF_RACE_INDEX},
+    {"creature_vector", FIND_CREATURE_VECTOR},
+    {"position_vector", FIND_POSITION_VECTOR},
+    {"narrowing_vectors_of_size", FIND_NARROWING_VECTORS_OF_SIZE},
+    {"squads_vector", FIND_SQUADS_VECTOR},
+    {"current_year", FIND_CURRENT_YEAR},
+};
+static const int JOB_COUNT = sizeof(JOB_NAMES) / sizeof(JOB_NAMES[0]);
+
+static QString json(const QString &str) {
+    QString out = "\"";
+    foreach(QChar c, str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c.unicode() < 0x20) {
+            out += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static QString json_object(const QStringList &members) {
+    return "{" + members.join(", ") + "}";
+}
+
+static QString json_member(const QString &name, const QString &value) {
+    return json(name) + ": " + value;
+}
+
+//! collects what a scanner thread reports
+class CliJobResults : public QObject {
+    Q_OBJECT
+public:
+    CliJobResults(quint32 memory_correction)
+        : m_memory_correction(memory_correction)
+    {}
+    QStringList found;
+
+public slots:
+    void address(const QString &name, const quint32 &addr) {
+        found << json_object(QStringList()
+            << json_member("name", json(name))
+            << json_member("address", json(hexify(addr)))
+            << json_member("corrected", json(hexify(addr - m_memory_correction))));
+    }
+    void offset(const QString &name, const int &offset) {
+        found << json_object(QStringList()
+            << json_member("name", json(name))
+            << json_member("offset", json(hexify(offset))));
+    }
+
+private:
+    quint32 m_memory_correction;
+};
+
+/* vectors_of_size takes [=<>]COUNT[,START,END], the operator defaulting to
+   = and the range (hex, like the scanner's fields) to all of memory */
+static bool vector_search_params(const QString &arg,
+                                 VectorSearchParams &params) {
+    QStringList parts = arg.split(',');
+    QString count = parts.at(0).trimmed();
+    params.op = '=';
+    if (!count.isEmpty() && QString("=<>").contains(count.at(0))) {
+        params.op = count.at(0).toAscii();
+        count = count.mid(1);
+    }
+    bool ok;
+    params.target_count = count.toUInt(&ok);
+    params.start_addr = 0;
+    params.end_addr = 0xffffffff;
+    if (parts.size() == 3) {
+        bool start_ok, end_ok;
+        params.start_addr = parts.at(1).trimmed().toUInt(&start_ok, 16);
+        params.end_addr = parts.at(2).trimmed().toUInt(&end_ok, 16);
+        ok = ok && start_ok && end_ok;
+    } else if (parts.size() != 1) {
+        ok = false;
+    }
+    return ok;
+}
+
+static QString run_job(DFInstance *df, SCANNER_JOB_TYPE type,
+                       const QString &name, const QString &arg) {
+    ScannerThread *thread = new ScannerThread;
+    thread->set_job(type);
+    QByteArray meta = arg.toLocal8Bit();
+    if (type == FIND_NULL_TERMINATED_STRING) {
+        NullTerminatedStringSearchParams params;
+        params.start_addr = 0;
+        params.end_addr = 0xffffffff;
+        params.size = qMin((size_t)meta.size(), sizeof(params.data));
+        memcpy(params.data, meta.data(), params.size);
+        meta = QByteArray((const char *)&params, sizeof(params));
+    } else if (type == FIND_VECTORS_OF_SIZE) {
+        // checked by main() already
+        VectorSearchParams params;
+        vector_search_params(arg, params);
+        meta = QByteArray((const char *)&params, sizeof(params));
+    }
+    thread->set_meta(meta);
+
+    CliJobResults results(df->get_memory_correction());
+    QObject::connect(thread, SIGNAL(found_address(const QString&, const quint32&)),
+                     &results, SLOT(address(const QString&, const quint32&)));
+    QObject::connect(thread, SIGNAL(found_offset(const QString&, const int&)),
+                     &results, SLOT(offset(const QString&, const int&)));
+    QEventLoop loop;
+    // queued after everything the job reported
+    QObject::connect(thread, SIGNAL(finished()), &loop, SLOT(quit()));
+    ScannerConnection::lend_to(thread);
+
+    QTime timer;
+    timer.start();
+    thread->start();
+    loop.exec();
+    int msecs = timer.elapsed();
+
+    QStringList members;
+    members << json_member("job", json(name))
+            << json_member("msecs", QString::number(msecs))
+            << json_member("found", "[" + results.found.join(", ") + "]");
+    QVector<VIRTADDR> *vectors = (QVector<VIRTADDR>*)thread->get_result();
+    if (vectors) {
+        QStringList addrs;
+        foreach(VIRTADDR addr, *vectors) {
+            addrs << json(hexify(addr));
+        }
+        members << json_member("vectors", "[" + addrs.join(", ") + "]");
+        delete vectors;
+    }
+    delete thread;
+    return json_object(members);
+}
+
+static QString load_dwarves(DFInstance *df, int runs) {
+    QTime timer;
+    timer.start();
+    DT->load_game_translation_tables(df);
+    int translation_msecs = timer.elapsed();
+
+    // the first run reads everything, later ones reuse what hasn't changed
+    // the way a refresh in the main window does
+    QStringList run_stats;
+    QHash<VIRTADDR, Dwarf*> previous;
+    int dwarves = 0;
+    for (int i = 0; i < runs; ++i) {
+        timer.restart();
+        QVector<Dwarf*> loaded = df->load_dwarves(i ? &previous : 0);
+        int msecs = timer.elapsed();
+        qDeleteAll(previous);
+        previous.clear();
+        foreach(Dwarf *d, loaded) {
+            previous.insert(d->address(), d);
+        }
+        dwarves = loaded.size();
+        run_stats << json_object(QStringList()
+            << json_member("msecs", QString::number(msecs))
+            << json_member("session_msecs",
+                           QString::number(df->last_session_msecs()))
+            << json_member("dwarves", QString::number(loaded.size())));
+    }
+    qDeleteAll(previous);
+
+    return json_object(QStringList()
+        << json_member("translation_msecs", QString::number(translation_msecs))
+        << json_member("dwarves", QString::number(dwarves))
+        << json_member("cache_hits", QString::number(df->cache_hits()))
+        << json_member("cache_misses", QString::number(df->cache_misses()))
+        << json_member("runs", "[" + run_stats.join(", ") + "]"));
+}
+
+static void usage() {
+    QStringList jobs;
+    for (int i = 0; i < JOB_COUNT; ++i) {
+        jobs << JOB_NAMES[i].name;
+    }
+    QTextStream(stderr)
+        << "usage: DwarfTherapistCli [--snapshot FILE] [--job NAME[=ARG]]...\n"
+        << "                         [--load-dwarves] [--repeat N]\n"
+        << "jobs: " << jobs.join(", ") << "\n"
+        << "ARG is the text or number the job looks for, where it needs one\n"
+        << "vectors_of_size takes [=<>]COUNT[,START,END], START and END in hex\n";
+}
+
+int main(int argc, char *argv[]) {
+    if (!DFInstance::authorize()) {
+        return 1;
+    }
+    DwarfTherapist app(argc, argv, true);
+
+    QString snapshot;
+    QList<QPair<int, QString> > jobs; // JOB_NAMES index, argument
+    bool read_dwarves = false;
+    int runs = 1;
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        QString arg = args.at(i);
+        if (arg == "--snapshot" && i + 1 < args.size()) {
+            snapshot = args.at(++i);
+        } else if (arg == "--job" && i + 1 < args.size()) {
+            QString name = args.at(++i).section('=', 0, 0);
+            int job = -1;
+            for (int j = 0; j < JOB_COUNT; ++j) {
+                if (name == JOB_NAMES[j].name)
+                    job = j;
+            }
+            VectorSearchParams params;
+            if (job == -1 || (JOB_NAMES[job].type == FIND_VECTORS_OF_SIZE
+                              && !vector_search_params(args.at(i).section('=', 1),
+                                                       params))) {
+                usage();
+                return 2;
+            }
+            jobs << qMakePair(job, args.at(i).section('=', 1));
+        } else if (arg == "--load-dwarves") {
+            read_dwarves = true;
+        } else if (arg == "--repeat" && i + 1 < args.size()) {
+            runs = qMax(1, args.at(++i).toInt());
+        } else if (arg != "-debug" && arg != "-trace") {
+            usage();
+            return 2;
+        }
+    }
+    if (jobs.isEmpty() && !read_dwarves) {
+        usage();
+        return 2;
+    }
+
+    QTime timer;
+    timer.start();
+    DFInstance *df = snapshot.isEmpty() ? DFInstance::newInstance()
+                                        : new DFInstanceSnapshot(snapshot);
+    bool connected = df->find_running_copy(!jobs.isEmpty());
+    MemoryLayout *layout = df->memory_layout();
+    QStringList connection;
+    connection << json_member("ok", connected ? "true" : "false")
+               << json_member("source", json(snapshot.isEmpty() ? "live"
+                                                                 : snapshot))
+               << json_member("msecs", QString::number(timer.elapsed()));
+    if (connected) {
+        connection << json_member("checksum",
+                                  json(hexify(df->calculate_checksum())))
+                   << json_member("version", layout ? json(layout->game_version())
+                                                    : QString("null"));
+    }
+    QStringList out;
+    out << json_member("connection", json_object(connection));
+
+    bool ok = connected;
+    if (connected && !jobs.isEmpty()) {
+        // the jobs borrow this connection instead of making their own
+        ScannerConnection::adopt(df);
+        QStringList job_results;
+        for (int i = 0; i < jobs.size(); ++i) {
+            int job = jobs.at(i).first;
+            job_results << run_job(df, JOB_NAMES[job].type,
+                                   JOB_NAMES[job].name, jobs.at(i).second);
+        }
+        out << json_member("jobs", "[" + job_results.join(", ") + "]");
+    }
+    if (connected && read_dwarves) {
+        if (layout && layout->is_valid()) {
+            df->set_memory_layout(layout);
+            out << json_member("load_dwarves", load_dwarves(df, runs));
+        } else {
+            LOGE << "no usable memory layout, can't read dwarves";
+            ok = false;
+        }
+    }
+
+    QTextStream(stdout) << json_object(out) << "\n";
+
+    if (connected && !jobs.isEmpty()) {
+        ScannerConnection::close();
+    } else {
+        delete df;
+    }
+    return ok ? 0 : 1;
+}
+
+#include "climain.moc"
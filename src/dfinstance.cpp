@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include <QtDebug>
 #include "defines.h"
 #include "dfinstance.h"
+#include "dfinstancesnapshot.h"
 #include "dwarf.h"
 #include "squad.h"
 #include "word.h"
@@ -34,6 +35,9 @@ THE SOFTWARE.
 #include "cp437codec.h"
 #include "dwarftherapist.h"
 #include "memorysegment.h"
+#include "scanengine.h"
+#include "pointerindex.h"
+#include "diffscan.h"
 #include "truncatingfilelogger.h"
 #include "mainwindow.h"
 
@@ -52,6 +56,11 @@ THE SOFTWARE.
 #endif
 #endif
 
+static bool compare_write_addr(const QPair<VIRTADDR, QByteArray> &a,
+                               const QPair<VIRTADDR, QByteArray> &b) {
+    return a.first < b.first;
+}
+
 DFInstance::DFInstance(QObject* parent)
     : QObject(parent)
     , m_pid(0)
@@ -60,11 +69,25 @@ DFInstance::DFInstance(QObject* parent)
     , m_is_ok(true)
     , m_bytes_scanned(0)
     , m_layout(0)
+    , m_last_range_hit(0)
+    , m_remap_pending(false)
     , m_attach_count(0)
     , m_heartbeat_timer(new QTimer(this))
+    , m_scan_scope(MemorySegment::SEG_ALL & ~(MemorySegment::SEG_LIBRARY |
+                                              MemorySegment::SEG_STACK))
     , m_memory_remap_timer(new QTimer(this))
     , m_scan_speed_timer(new QTimer(this))
     , m_dwarf_race_id(0)
+    , m_page_cache(4096) // 16MB worth of pages
+    , m_cache_enabled(false)
+    , m_read_generation(0)
+    , m_cache_hits(0)
+    , m_cache_misses(0)
+    , m_session_depth(0)
+    , m_last_session_msecs(0)
+    , m_live_reads(false)
+    , m_torn_reads(0)
+    , m_pointer_index(0)
 {
     connect(m_scan_speed_timer, SIGNAL(timeout()),
             SLOT(calculate_scan_rate()));
@@ -115,6 +138,7 @@ DFInstance::~DFInstance() {
         delete(l);
     }
     m_memory_layouts.clear();
+    delete m_pointer_index;
 }
 
 DFInstance * DFInstance::newInstance() {
@@ -131,142 +155,640 @@ DFInstance * DFInstance::newInstance() {
 #endif
 }
 
-BYTE DFInstance::read_byte(const VIRTADDR &addr) {
-    QByteArray out;
-    read_raw(addr, sizeof(BYTE), out);
-    return out.at(0);
+int DFInstance::read_remote(const VIRTADDR &addr, int bytes, void *buffer) {
+    QByteArray out(bytes, 0);
+    int bytes_read = read_raw(addr, bytes, out);
+    memcpy(buffer, out.constData(), qMin(bytes, out.size()));
+    return bytes_read;
 }
 
-WORD DFInstance::read_word(const VIRTADDR &addr) {
-    QByteArray out;
-    read_raw(addr, sizeof(WORD), out);
-    return decode_word(out);
+int DFInstance::read_remote_batch(QVector<ReadRequest> &requests) {
+    int total = 0;
+    for (int i = 0; i < requests.size(); ++i) {
+        ReadRequest &r = requests[i];
+        r.bytes_read = read_remote(r.addr, r.bytes, r.buffer);
+        total += r.bytes_read;
+    }
+    return total;
 }
 
-VIRTADDR DFInstance::read_addr(const VIRTADDR &addr) {
-    QByteArray out;
-    read_raw(addr, sizeof(VIRTADDR), out);
-    return decode_dword(out);
+int DFInstance::read_mem(const VIRTADDR &addr, int bytes, void *buffer) {
+    if (caching() && bytes <= MAX_CACHED_READ) {
+        return read_cached(addr, bytes, static_cast<char*>(buffer));
+    }
+    return read_remote(addr, bytes, buffer);
 }
 
-qint16 DFInstance::read_short(const VIRTADDR &addr) {
-    QByteArray out;
-    read_raw(addr, sizeof(qint16), out);
-    return decode_short(out);
+int DFInstance::read_batch(QVector<ReadRequest> &requests) {
+    if (!caching()) {
+        return read_remote_batch(requests);
+    }
+
+    // work out which pages we don't have yet and pull them all in one batch
+    QVector<ReadRequest> fetch;
+    QSet<VIRTADDR> wanted;
+    foreach(const ReadRequest &r, requests) {
+        if (r.bytes > MAX_CACHED_READ)
+            continue;
+        quint64 end = (quint64)r.addr + r.bytes;
+        for (quint64 page = r.addr & ~(CACHE_PAGE_SIZE - 1); page < end;
+             page += CACHE_PAGE_SIZE) {
+            if (m_page_cache.contains(page) || wanted.contains(page)) {
+                m_cache_hits++;
+            } else {
+                m_cache_misses++;
+                wanted.insert(page);
+                fetch << ReadRequest(page, CACHE_PAGE_SIZE, new char[CACHE_PAGE_SIZE]);
+            }
+        }
+    }
+    if (!fetch.isEmpty()) {
+        read_remote_batch(fetch);
+        foreach(const ReadRequest &f, fetch) {
+            if (f.bytes_read == CACHE_PAGE_SIZE) {
+                m_page_cache.insert(f.addr, new QByteArray(
+                        static_cast<char*>(f.buffer), CACHE_PAGE_SIZE));
+            }
+            delete[] static_cast<char*>(f.buffer);
+        }
+    }
+
+    int total = 0;
+    for (int i = 0; i < requests.size(); ++i) {
+        ReadRequest &r = requests[i];
+        if (r.bytes > MAX_CACHED_READ) {
+            r.bytes_read = read_remote(r.addr, r.bytes, r.buffer);
+        } else {
+            r.bytes_read = read_cached(r.addr, r.bytes,
+                                       static_cast<char*>(r.buffer));
+        }
+        total += r.bytes_read;
+    }
+    return total;
 }
 
-qint32 DFInstance::read_int(const VIRTADDR &addr) {
-    QByteArray out;
-    read_raw(addr, sizeof(qint32), out);
-    return decode_int(out);
+int DFInstance::read_stable(QVector<ReadRequest> &requests) {
+    int total = read_batch(requests);
+    if (!m_live_reads)
+        return total;
+
+    // DF is still running, so read it all again and keep whatever moved
+    // until two reads in a row agree
+    for (int attempt = 0; attempt < MAX_TORN_RETRIES; ++attempt) {
+        QVector<QByteArray> copies;
+        copies.reserve(requests.size());
+        QVector<ReadRequest> check;
+        check.reserve(requests.size());
+        foreach(const ReadRequest &r, requests) {
+            copies << QByteArray(r.bytes, 0);
+            check << ReadRequest(r.addr, r.bytes, copies.last().data());
+        }
+        read_batch(check);
+
+        bool torn = false;
+        for (int i = 0; i < requests.size(); ++i) {
+            ReadRequest &r = requests[i];
+            if (memcmp(r.buffer, check[i].buffer, r.bytes) != 0) {
+                memcpy(r.buffer, check[i].buffer, r.bytes);
+                r.bytes_read = check[i].bytes_read;
+                torn = true;
+                m_torn_reads++;
+            }
+        }
+        if (!torn)
+            return total;
+    }
+    LOGW << "reads of" << requests.size() << "fields kept changing after"
+            << MAX_TORN_RETRIES << "retries, using the last copy";
+    return total;
 }
 
-QVector<VIRTADDR> DFInstance::scan_mem(const QByteArray &needle, const uint start_addr, const uint end_addr) {
-    // progress reporting
-    m_scan_speed_timer->start(500);
-    m_memory_remap_timer->stop(); // don't remap segments while scanning
-    int total_bytes = 0;
-    m_bytes_scanned = 0; // for global timings
-    int bytes_scanned = 0; // for progress calcs
-    foreach(MemorySegment *seg, m_regions) {
-        total_bytes += seg->size;
+QByteArray *DFInstance::cached_page(const VIRTADDR &page) {
+    QByteArray *data = m_page_cache.object(page);
+    if (data)
+        return data;
+    m_cache_misses++;
+    QByteArray buf(CACHE_PAGE_SIZE, 0);
+    if (read_remote(page, CACHE_PAGE_SIZE, buf.data()) != CACHE_PAGE_SIZE) {
+        return 0; // not mapped, don't remember it
     }
-    int report_every_n_bytes = total_bytes / 1000;
-    emit scan_total_steps(1000);
-    emit scan_progress(0);
+    data = new QByteArray(buf);
+    m_page_cache.insert(page, data);
+    return data;
+}
 
+int DFInstance::read_cached(const VIRTADDR &addr, int bytes, char *out) {
+    int bytes_read = 0;
+    quint64 ptr = addr;
+    quint64 end = (quint64)addr + bytes;
+    while (ptr < end) {
+        VIRTADDR page = ptr & ~(CACHE_PAGE_SIZE - 1);
+        int offset = ptr - page;
+        int len = qMin<quint64>(CACHE_PAGE_SIZE - offset, end - ptr);
+        bool had_it = m_page_cache.contains(page);
+        QByteArray *data = cached_page(page);
+        if (data) {
+            if (had_it)
+                m_cache_hits++;
+            memcpy(out + (ptr - addr), data->constData() + offset, len);
+            bytes_read += len;
+        } else {
+            memset(out + (ptr - addr), 0, len);
+        }
+        ptr += len;
+    }
+    return bytes_read;
+}
 
-    m_stop_scan = false;
-    QVector<VIRTADDR> addresses; //! return value
-    QByteArrayMatcher matcher(needle);
+void DFInstance::invalidate_cached_range(const VIRTADDR &addr, int bytes) {
+    quint64 end = (quint64)addr + bytes;
+    for (quint64 page = addr & ~(CACHE_PAGE_SIZE - 1); page < end; page += CACHE_PAGE_SIZE) {
+        m_page_cache.remove(page);
+    }
+}
+
+int DFInstance::write_remote_batch(QVector<ReadRequest> &writes) {
+    int total = 0;
+    for (int i = 0; i < writes.size(); ++i) {
+        ReadRequest &w = writes[i];
+        w.bytes_read = qMin(w.bytes, write_raw(w.addr, w.bytes, w.buffer));
+        total += w.bytes_read;
+    }
+    return total;
+}
 
-    int step_size = 0x1000;
-    QByteArray buffer(step_size, 0);
-    QByteArray back_buffer(step_size * 2, 0);
+void DFInstance::queue_write(const VIRTADDR &addr, const QByteArray &data) {
+    if (!data.isEmpty())
+        m_queued_writes << qMakePair(addr, data);
+}
 
+bool DFInstance::commit_writes() {
+    if (m_queued_writes.isEmpty())
+        return true;
     QTime timer;
     timer.start();
-    attach();
-    foreach(MemorySegment *seg, m_regions) {
-        int step = step_size;
-        int steps = seg->size / step;
-        if (seg->size % step)
-            steps++;
 
-        if( seg->end_addr < start_addr ) {
-            continue;
+    // work out the merged ranges: overlapping and touching writes go out as
+    // one contiguous block
+    QList<QPair<VIRTADDR, QByteArray> > sorted = m_queued_writes;
+    qStableSort(sorted.begin(), sorted.end(), compare_write_addr);
+    QVector<VIRTADDR> starts;
+    QVector<VIRTADDR> ends; // exclusive
+    for (int i = 0; i < sorted.size(); ++i) {
+        VIRTADDR start = sorted.at(i).first;
+        VIRTADDR end = start + sorted.at(i).second.size();
+        if (!ends.isEmpty() && start <= ends.last()) {
+            ends.last() = qMax(ends.last(), end);
+        } else {
+            starts << start;
+            ends << end;
         }
+    }
 
-        if( seg->start_addr > end_addr ) {
-            break;
+    // lay the writes over their blocks in the order they were queued
+    QVector<QByteArray> blocks(starts.size());
+    for (int i = 0; i < starts.size(); ++i) {
+        blocks[i] = QByteArray(ends.at(i) - starts.at(i), 0);
+    }
+    QVector<QByteArray> originals = blocks;
+    QVector<ReadRequest> reads;
+    for (int i = 0; i < starts.size(); ++i) {
+        reads << ReadRequest(starts.at(i), blocks.at(i).size(),
+                             originals[i].data());
+    }
+
+    DFReadSession session(this);
+    // anything we don't overwrite keeps what DF has now, which is also what
+    // we'd roll back to
+    read_batch(reads);
+    foreach(const ReadRequest &r, reads) {
+        if (r.bytes_read != r.bytes) {
+            LOGE << "unable to read" << r.bytes << "bytes at" << hexify(r.addr)
+                    << "before writing, nothing was written";
+            return false;
         }
+    }
+    for (int i = 0; i < blocks.size(); ++i) {
+        blocks[i] = originals.at(i);
+        blocks[i].detach();
+    }
+    typedef QPair<VIRTADDR, QByteArray> QueuedWrite;
+    foreach(const QueuedWrite &w, m_queued_writes) {
+        const VIRTADDR *it = qUpperBound(starts.constBegin(), starts.constEnd(),
+                                         w.first) - 1;
+        int idx = it - starts.constBegin();
+        memcpy(blocks[idx].data() + (w.first - starts.at(idx)),
+               w.second.constData(), w.second.size());
+    }
 
-        for(VIRTADDR ptr = seg->start_addr; ptr < seg->end_addr; ptr += step) {
+    QVector<ReadRequest> writes;
+    for (int i = 0; i < blocks.size(); ++i) {
+        writes << ReadRequest(starts.at(i), blocks.at(i).size(),
+                              blocks[i].data());
+    }
+    write_remote_batch(writes);
+    for (int i = 0; i < starts.size(); ++i) {
+        invalidate_cached_range(starts.at(i), blocks.at(i).size());
+    }
 
-            if( ptr < start_addr ) {
-                continue;
+    // read it all back in one go
+    QVector<QByteArray> check(blocks.size());
+    QVector<ReadRequest> verify;
+    for (int i = 0; i < blocks.size(); ++i) {
+        check[i] = QByteArray(blocks.at(i).size(), 0);
+        verify << ReadRequest(starts.at(i), check.at(i).size(),
+                              check[i].data());
+    }
+    read_batch(verify);
+    bool ok = true;
+    for (int i = 0; i < blocks.size(); ++i) {
+        if (writes.at(i).bytes_read != writes.at(i).bytes
+            || check.at(i) != blocks.at(i)) {
+            LOGE << "write of" << blocks.at(i).size() << "bytes at"
+                    << hexify(starts.at(i)) << "did not stick";
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        // put back every block we touched
+        QVector<ReadRequest> rollback;
+        for (int i = 0; i < originals.size(); ++i) {
+            if (writes.at(i).bytes_read > 0) {
+                rollback << ReadRequest(starts.at(i), originals.at(i).size(),
+                                        originals[i].data());
             }
-            if( ptr > end_addr ) {
-                m_stop_scan = true;
-                break;
+        }
+        write_remote_batch(rollback);
+        foreach(const ReadRequest &r, rollback) {
+            invalidate_cached_range(r.addr, r.bytes);
+            if (r.bytes_read != r.bytes) {
+                LOGE << "unable to roll back" << r.bytes << "bytes at"
+                        << hexify(r.addr);
             }
+        }
+        LOGE << "write plan failed, rolled back" << rollback.size()
+                << "blocks";
+        return false;
+    }
+    LOGI << "committed" << m_queued_writes.size() << "writes as"
+            << blocks.size() << "blocks in" << timer.elapsed() << "ms";
+    m_queued_writes.clear();
+    return true;
+}
 
-            step = step_size;
-            if (ptr + step > seg->end_addr) {
-                step = seg->end_addr - ptr;
-            }
+QString DFInstance::read_tracked_string(const VIRTADDR &addr,
+                                        QVector<ReadRequest> &extents) {
+#ifdef Q_WS_WIN
+    return read_msvc_string(addr, &extents);
+#else
+    return read_libstdcxx_string(addr, &extents);
+#endif
+}
 
-            // move the last thing we read to the front of the back_buffer
-            back_buffer.replace(0, step, buffer);
+QString DFInstance::read_msvc_string(const VIRTADDR &addr,
+                                     QVector<ReadRequest> *extents) {
+    MemoryLayout *mem = m_layout;
+    qint32 len = 0;
+    qint32 cap = 0;
+    QVector<ReadRequest> batch;
+    batch << ReadRequest(addr + (mem ? mem->string_length_offset() :
+                         STRING_BUFFER_OFFSET + STRING_LENGTH_OFFSET),
+                         sizeof(len), &len)
+          << ReadRequest(addr + (mem ? mem->string_cap_offset() :
+                         STRING_BUFFER_OFFSET + STRING_CAP_OFFSET),
+                         sizeof(cap), &cap);
+    read_batch(batch);
+    if (extents) // the capacity is the struct's last member
+        *extents << ReadRequest(addr, batch.at(1).addr + sizeof(cap) - addr);
+    if (len > cap || len < 0 || len > MAX_STRING_LENGTH) {
+#ifdef _DEBUG
+        // probaby not really a string
+        LOGW << "Tried to read a string at" << hex << addr
+            << "but it was totally not a string...";
+#endif
+        return QString();
+    }
 
-            // fill the main read buffer
-            int bytes_read = read_raw(ptr, step, buffer);
-            if (bytes_read < step && !seg->is_guarded) {
-                if (m_layout->is_complete()) {
-                    LOGW << "tried to read" << step << "bytes starting at" <<
-                            hexify(ptr) << "but only got" << dec << bytes_read;
-                }
-                continue;
+    // short strings are kept inline, longer ones on the heap
+    VIRTADDR buffer_addr = addr + (mem ? mem->string_buffer_offset() :
+                                   STRING_BUFFER_OFFSET);
+    if (cap >= 16) {
+        buffer_addr = read_addr(buffer_addr);
+        if (extents)
+            *extents << ReadRequest(buffer_addr, len);
+    }
+    return pooled_string(get_data(buffer_addr, len));
+}
+
+QString DFInstance::read_libstdcxx_string(const VIRTADDR &addr,
+                                          QVector<ReadRequest> *extents) {
+    MemoryLayout *mem = m_layout;
+    uint buffer_offset = mem ? mem->string_buffer_offset() : STRING_BUFFER_OFFSET;
+    VIRTADDR buffer_addr = read_addr(addr + buffer_offset);
+    if (extents)
+        *extents << ReadRequest(addr + buffer_offset, sizeof(VIRTADDR));
+    if (!buffer_addr)
+        return QString();
+
+    // the length and capacity sit in front of the characters themselves
+    qint32 len = 0;
+    qint32 cap = 0;
+    QVector<ReadRequest> batch;
+    batch << ReadRequest(buffer_addr + ((mem ? mem->string_length_offset() :
+                         STRING_LENGTH_OFFSET) - buffer_offset),
+                         sizeof(len), &len)
+          << ReadRequest(buffer_addr + ((mem ? mem->string_cap_offset() :
+                         STRING_CAP_OFFSET) - buffer_offset),
+                         sizeof(cap), &cap);
+    read_batch(batch);
+    if (len > cap || len < 0 || len > MAX_STRING_LENGTH) {
+#ifdef _DEBUG
+        LOGW << "Tried to read a string at" << hex << addr
+            << "but it was totally not a string...";
+#endif
+        return QString();
+    }
+    if (extents) // from the length in front of the characters to their end
+        *extents << ReadRequest(batch.at(0).addr,
+                                buffer_addr + len - batch.at(0).addr);
+    return pooled_string(get_data(buffer_addr, len));
+}
+
+QString DFInstance::pooled_string(const QByteArray &raw) {
+    QHash<QByteArray, QString>::const_iterator it = m_string_pool.constFind(raw);
+    if (it != m_string_pool.constEnd())
+        return it.value();
+
+    if (m_string_pool.size() > 100000) {
+        // scanning can read a lot of junk, don't hang on to all of it
+        m_string_pool.clear();
+    }
+    QString decoded = CP437Codec::shared()->toUnicode(raw);
+    m_string_pool.insert(raw, decoded);
+    return decoded;
+}
+
+void DFInstance::new_read_generation() {
+    m_page_cache.clear();
+    m_cache_enabled = true;
+    m_read_generation++;
+    TRACE << "starting read generation" << m_read_generation;
+}
+
+void DFInstance::begin_read_session() {
+    if (m_session_depth++ > 0)
+        return;
+    m_session_timer.start();
+    if (m_remap_pending) {
+        m_remap_pending = false;
+        map_virtual_memory();
+    }
+    attach();
+    new_read_generation();
+}
+
+void DFInstance::end_read_session() {
+    if (m_session_depth == 0) {
+        LOGW << "end_read_session called without a matching begin";
+        return;
+    }
+    if (--m_session_depth > 0)
+        return;
+    detach();
+    m_last_session_msecs = m_session_timer.elapsed();
+    int budget = DT->user_settings()->value(
+            "options/read_session_budget_ms", 100).toInt();
+    if (m_last_session_msecs > budget) {
+        LOGW << "read session held DF stopped for" << m_last_session_msecs
+                << "ms (budget" << budget << "ms)";
+    } else {
+        LOGD << "read session held DF stopped for" << m_last_session_msecs
+                << "ms";
+    }
+    emit read_session_finished(m_last_session_msecs);
+}
+
+void DFInstance::drop_read_cache() {
+    if (m_cache_enabled) {
+        LOGD << "read generation" << m_read_generation << "page cache hits:"
+                << m_cache_hits << "misses:" << m_cache_misses;
+    }
+    m_page_cache.clear();
+    m_cache_enabled = false;
+}
+
+BYTE DFInstance::read_byte(const VIRTADDR &addr) {
+    BYTE out = 0;
+    read_mem(addr, sizeof(BYTE), &out);
+    return out;
+}
+
+WORD DFInstance::read_word(const VIRTADDR &addr) {
+    WORD out = 0;
+    read_mem(addr, sizeof(WORD), &out);
+    return out;
+}
+
+VIRTADDR DFInstance::read_addr(const VIRTADDR &addr) {
+    VIRTADDR out = 0;
+    read_mem(addr, sizeof(VIRTADDR), &out);
+    return out;
+}
+
+qint16 DFInstance::read_short(const VIRTADDR &addr) {
+    qint16 out = 0;
+    read_mem(addr, sizeof(qint16), &out);
+    return out;
+}
+
+qint32 DFInstance::read_int(const VIRTADDR &addr) {
+    qint32 out = 0;
+    read_mem(addr, sizeof(qint32), &out);
+    return out;
+}
+
+QVector<VIRTADDR> DFInstance::scan_mem(const QByteArray &needle, const uint start_addr, const uint end_addr) {
+    NeedleKernel kernel(needle);
+    TRACE << "searching for" << needle.size() << "bytes using"
+            << kernel.search_name();
+    return run_scan(&kernel, start_addr, end_addr);
+}
+
+QHash<VIRTADDR, QVector<VIRTADDR> > DFInstance::scan_pointers(
+        const QVector<VIRTADDR> &targets, const uint start_addr,
+        const uint end_addr) {
+    QHash<VIRTADDR, QVector<VIRTADDR> > found;
+    if (targets.isEmpty())
+        return found;
+    if (m_pointer_index) {
+        foreach(VIRTADDR target, targets) {
+            QVector<VIRTADDR> where;
+            foreach(VIRTADDR addr, m_pointer_index->pointers_to(target)) {
+                if (addr >= start_addr && addr <= end_addr)
+                    where << addr;
             }
-            bytes_scanned += bytes_read;
-            m_bytes_scanned += bytes_read;
-
-            // put the main buffer on the end of the back_buffer
-            back_buffer.replace(step, step, buffer);
-
-            int idx = -1;
-            forever {
-                idx = matcher.indexIn(back_buffer, idx+1);
-                if (idx == -1) {
-                    break;
-                } else {
-                    VIRTADDR hit = ptr + idx - step;
-                    if (!addresses.contains(hit)) {
-                        // backbuffer may cause duplicate hits
-                        addresses << hit;
-                    }
-                }
+            if (!where.isEmpty())
+                found.insert(target, where);
+        }
+        return found;
+    }
+    // hold DF still from the scan until we've read back what we found
+    DFReadSession session(this);
+    PointerSetKernel kernel(targets);
+    QVector<VIRTADDR> hits = run_scan(&kernel, start_addr, end_addr);
+
+    // the workers only kept where, read back what each hit was
+    QSet<VIRTADDR> wanted = QSet<VIRTADDR>::fromList(targets.toList());
+    QVector<VIRTADDR> values(hits.size());
+    QVector<ReadRequest> reads;
+    reads.reserve(hits.size());
+    for (int i = 0; i < hits.size(); ++i) {
+        reads << ReadRequest(hits.at(i), sizeof(VIRTADDR), &values[i]);
+    }
+    read_batch(reads);
+    for (int i = 0; i < hits.size(); ++i) {
+        if (wanted.contains(values.at(i)))
+            found[values.at(i)] << hits.at(i);
+    }
+    return found;
+}
+
+bool DFInstance::build_pointer_index() {
+    drop_pointer_index();
+    ValidPointerKernel kernel(m_range_starts, m_range_ends);
+    QVector<VIRTADDR> records = run_scan(&kernel);
+    if (m_stop_scan)
+        return false;
+    QTime timer;
+    timer.start();
+    m_pointer_index = new PointerIndex(records);
+    LOGD << QString("Indexed %L1 pointers in %L2ms")
+            .arg(m_pointer_index->size()).arg(timer.elapsed());
+    return true;
+}
+
+void DFInstance::drop_pointer_index() {
+    delete m_pointer_index;
+    m_pointer_index = 0;
+}
+
+QVector<VIRTADDR> DFInstance::pointers_to(const VIRTADDR &target) {
+    if (m_pointer_index)
+        return m_pointer_index->pointers_to(target);
+    return scan_pointers(QVector<VIRTADDR>() << target).value(target);
+}
+
+bool DFInstance::start_diff_scan(DiffScan *scan) {
+    scan->reset();
+    DiffKernel kernel(scan);
+    run_scan(&kernel);
+    scan->finish_pass();
+    LOGD << QString("Differential scan started with %L1 candidates in %L2 pages")
+            .arg(scan->candidate_count()).arg(scan->page_count());
+    return !m_stop_scan;
+}
+
+bool DFInstance::filter_diff_scan(DiffScan *scan, int filter, qint32 value) {
+    if (!scan->started())
+        return start_diff_scan(scan);
+    ScanEngine engine;
+    QPair<VIRTADDR, VIRTADDR> run;
+    foreach(run, scan->page_runs()) {
+        engine.add_range(run.first, run.second, run.second);
+    }
+    DiffKernel kernel(scan, (DiffScan::FILTER)filter, value);
+    run_engine(&engine, &kernel);
+    scan->finish_pass();
+    LOGD << QString("Differential scan has %L1 candidates left in %L2 pages")
+            .arg(scan->candidate_count()).arg(scan->page_count());
+    return !m_stop_scan;
+}
+
+QVector<VIRTADDR> DFInstance::run_scan(ScanKernel *kernel,
+                                       const uint start_addr,
+                                       const uint end_addr) {
+    // queue up every run of pages DF has touched in the segments we scan
+    ScanEngine engine;
+    quint64 scan_end = (quint64)end_addr + 1;
+    foreach(MemorySegment *seg, m_regions) {
+        if (!in_scan_scope(seg) || seg->end_addr <= start_addr
+            || seg->start_addr >= scan_end) {
+            continue;
+        }
+        QBitArray resident = resident_pages(seg->start_addr, seg->end_addr);
+        quint64 run_start = 0;
+        bool in_run = false;
+        for (int page = 0; page <= resident.size(); ++page) {
+            bool here = page < resident.size() && resident.testBit(page);
+            quint64 page_addr = qMin<quint64>(seg->end_addr,
+                                    (quint64)seg->start_addr + page * 0x1000);
+            if (here && !in_run) {
+                run_start = page_addr;
+                in_run = true;
+            } else if (!here && in_run) {
+                quint64 start = qMax<quint64>(run_start, start_addr);
+                quint64 end = qMin<quint64>(page_addr, scan_end);
+                if (start < end)
+                    engine.add_range(start, end, seg->end_addr);
+                in_run = false;
             }
+        }
+    }
+    return run_engine(&engine, kernel);
+}
 
-            if (m_stop_scan)
-                break;
-            emit scan_progress(bytes_scanned / report_every_n_bytes);
+QVector<VIRTADDR> DFInstance::run_engine(ScanEngine *engine,
+                                         ScanKernel *kernel) {
+    bool remapping = m_memory_remap_timer->isActive();
+    m_memory_remap_timer->stop(); // don't remap segments while scanning
+    m_stop_scan = false;
+    attach();
+
+    QList<ScanReader*> readers;
+    int workers = qMax(1, QThread::idealThreadCount());
+    for (int i = 0; i < workers; ++i) {
+        readers << new_scan_reader();
+    }
+    emit scan_total_steps(1000);
+    emit scan_progress(0);
 
+    QTime timer;
+    timer.start();
+    engine->start(kernel, readers);
+    qint64 total_bytes = qMax<qint64>(1, engine->total_bytes());
+    qint64 rate_bytes = 0;
+    int rate_msecs = 0;
+    while (!engine->wait(100)) {
+        qint64 bytes_scanned = engine->bytes_scanned();
+        emit scan_progress(bytes_scanned * 1000 / total_bytes);
+        int elapsed = timer.elapsed();
+        if (elapsed - rate_msecs >= 500) {
+            float rate = ((bytes_scanned - rate_bytes) / 1024.0f / 1024.0f) /
+                         ((elapsed - rate_msecs) / 1000.0f);
+            emit scan_message(QString("%L1MB/s").arg(rate));
+            rate_bytes = bytes_scanned;
+            rate_msecs = elapsed;
         }
-        DT->processEvents();
-        if (m_stop_scan)
-            break;
+        if (m_stop_scan) // set by cancel_scan() from the GUI thread
+            engine->cancel();
     }
+    QVector<VIRTADDR> hits = engine->results();
     detach();
-    m_memory_remap_timer->start(20000); // start the remapper again
-    LOGD << QString("Scanned %L1MB in %L2ms").arg(bytes_scanned / 1024 * 1024)
-            .arg(timer.elapsed());
-    return addresses;
+    if (remapping)
+        m_memory_remap_timer->start(); // start the remapper again
+    emit scan_progress(1000);
+    LOGD << QString("Scanned %L1MB in %L2ms on %3 threads, %4 hits")
+            .arg(engine->bytes_scanned() / (1024 * 1024))
+            .arg(timer.elapsed()).arg(workers).arg(hits.size());
+    return hits;
 }
 
 bool DFInstance::looks_like_vector_of_pointers(const VIRTADDR &addr) {
-    int start = read_int(addr + 0x4);
-    int end = read_int(addr + 0x8);
+    qint32 header[2] = {0, 0}; // start and end pointers
+    read_mem(addr + 0x4, sizeof(header), header);
+    int start = header[0];
+    int end = header[1];
     int entries = (end - start) / sizeof(int);
     LOGD << "LOOKS LIKE VECTOR? unverified entries:" << entries;
 
@@ -287,7 +809,7 @@ void DFInstance::read_raws() {
     GameDataReader::ptr()->read_raws(m_df_dir);
 }
 
-QVector<Dwarf*> DFInstance::load_dwarves() {
+QVector<Dwarf*> DFInstance::load_dwarves(QHash<VIRTADDR, Dwarf*> *reusable) {
     map_virtual_memory();
     QVector<Dwarf*> dwarves;
     if (!m_is_ok) {
@@ -324,7 +846,7 @@ QVector<Dwarf*> DFInstance::load_dwarves() {
             hexify(dwarf_race_index - m_memory_correction) << "(UNCORRECTED)";
     emit progress_message(tr("Loading Dwarves"));
 
-    attach();
+    begin_read_session();
     // which race id is dwarven?
     m_dwarf_race_id = read_word(dwarf_race_index);
     LOGD << "dwarf race:" << hexify(m_dwarf_race_id);
@@ -335,7 +857,16 @@ QVector<Dwarf*> DFInstance::load_dwarves() {
     if (!entries.empty()) {
         Dwarf *d = 0;
         int i = 0;
+        int reused = 0;
         foreach(VIRTADDR creature_addr, entries) {
+            d = reusable ? reusable->value(creature_addr, 0) : 0;
+            if (d && d->is_unchanged()) {
+                reusable->remove(creature_addr);
+                dwarves.append(d);
+                reused++;
+                emit progress_value(i++);
+                continue;
+            }
             d = Dwarf::get_dwarf(this, creature_addr);
             if (d) {
                 dwarves.append(d);
@@ -346,11 +877,17 @@ QVector<Dwarf*> DFInstance::load_dwarves() {
             }
             emit progress_value(i++);
         }
+        if (reused) {
+            LOGI << "reused" << reused << "unchanged dwarves";
+        }
+        // DF is still stopped, so nothing can slip in between the reads
+        // above and marking everything clean
+        start_change_tracking();
     } else {
         // we lost the fort!
         m_is_ok = false;
     }
-    detach();
+    end_read_session();
     LOGI << "found" << dwarves.size() << "dwarves out of" << entries.size()
             << "creatures";
     return dwarves;
@@ -388,7 +925,7 @@ QVector<Squad*> DFInstance::load_squads() {
 
     emit progress_message(tr("Loading Squads"));
 
-    attach();
+    begin_read_session();
 
     QVector<VIRTADDR> entries = enumerate_vector(squad_vector);
     TRACE << "FOUND" << entries.size() << "squads";
@@ -407,31 +944,211 @@ QVector<Squad*> DFInstance::load_squads() {
         }
     }
 
-    detach();
+    end_read_session();
     LOGI << "Found" << squads.size() << "squads out of" << entries.size();
     return squads;
 }
 
+bool DFInstance::save_snapshot(const QString &filename) {
+    if (!m_is_ok || !m_layout) {
+        LOGW << "not connected, nothing to snapshot";
+        return false;
+    }
+    QFile f(filename);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        LOGE << "Unable to open" << filename << "for writing";
+        return false;
+    }
+
+    // hold DF still so every page comes from the same moment
+    DFReadSession session(this);
+    QByteArray checksum = m_layout->checksum().toUtf8();
+    QByteArray df_dir = m_df_dir.absolutePath().toUtf8();
+    quint32 strings_size = 8 + checksum.size() + df_dir.size();
+
+    QDataStream out(&f);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(DFInstanceSnapshot::MAGIC, 8);
+    out << DFInstanceSnapshot::FORMAT_VERSION
+        << DFInstanceSnapshot::platform_id()
+        << (quint32)m_pid << m_base_addr << m_lowest_address
+        << m_highest_address << m_heap_start_address << m_memory_correction
+        << (quint32)m_regions.size() << strings_size;
+    out << (quint32)checksum.size();
+    out.writeRawData(checksum.constData(), checksum.size());
+    out << (quint32)df_dir.size();
+    out.writeRawData(df_dir.constData(), df_dir.size());
+
+    // segment table, each segment's pages start on an aligned offset
+    const quint64 align = DFInstanceSnapshot::DATA_ALIGNMENT;
+    QVector<quint64> offsets;
+    quint64 offset = DFInstanceSnapshot::HEADER_SIZE + strings_size
+                     + m_regions.size() * DFInstanceSnapshot::SEGMENT_SIZE;
+    foreach(MemorySegment *seg, m_regions) {
+        offset = (offset + align - 1) & ~(align - 1);
+        offsets << offset;
+        out << seg->start_addr << seg->end_addr
+            << ((seg->is_heap ? DFInstanceSnapshot::SEGMENT_HEAP : 0)
+                | ((quint32)seg->type << DFInstanceSnapshot::SEGMENT_TYPE_SHIFT))
+            << offset;
+        offset += seg->size;
+    }
+
+    emit progress_message(tr("Capturing memory snapshot"));
+    emit progress_range(0, m_regions.size() - 1);
+    const int chunk_size = 0x10000;
+    QByteArray chunk(chunk_size, 0);
+    quint64 bytes_captured = 0;
+    for (int i = 0; i < m_regions.size(); ++i) {
+        MemorySegment *seg = m_regions.at(i);
+        f.seek(offsets.at(i));
+        // pages we can't read are kept as zeroes
+        for (quint64 ptr = seg->start_addr; ptr < seg->end_addr;
+             ptr += chunk_size) {
+            int len = qMin<quint64>(chunk_size, seg->end_addr - ptr);
+            read_mem(ptr, len, chunk.data());
+            out.writeRawData(chunk.constData(), len);
+        }
+        bytes_captured += seg->size;
+        emit progress_value(i);
+    }
+    f.close();
+    LOGI << "captured" << m_regions.size() << "segments ("
+            << bytes_captured / (1024 * 1024) << "MB) to" << filename;
+    return out.status() == QDataStream::Ok;
+}
+
+bool DFInstance::in_scan_scope(const MemorySegment *seg) {
+    return seg->type & m_scan_scope;
+}
+
+/*! fallback for platforms without a thread-safe way into DF's memory, the
+    workers take turns */
+class LockedScanReader : public ScanReader {
+public:
+    LockedScanReader(DFInstance *df, QMutex *lock)
+        : m_df(df)
+        , m_lock(lock)
+    {}
+    int read(const VIRTADDR &addr, int bytes, char *buffer) {
+        QMutexLocker locker(m_lock);
+        return m_df->read_remote(addr, bytes, buffer);
+    }
+private:
+    DFInstance *m_df;
+    QMutex *m_lock;
+};
+
+ScanReader *DFInstance::new_scan_reader() {
+    return new LockedScanReader(this, &m_scan_read_lock);
+}
+
+QBitArray DFInstance::resident_pages(const VIRTADDR &start,
+                                     const VIRTADDR &end) {
+    return QBitArray((end - start + 0xfff) / 0x1000, true);
+}
+
+void DFInstance::start_heartbeat() {
+    if (!DT->user_settings()->value("options/alert_on_lost_connection", true)
+        .toBool() || !m_layout || !m_layout->is_complete()) {
+        return;
+    }
+    m_heartbeat_fingerprint.clear();
+    m_heartbeat_timer->start(HEARTBEAT_MIN_MSECS);
+}
+
 void DFInstance::heartbeat() {
-    // simple read attempt that will fail if the DF game isn't running a fort,
-    // or isn't running at all
-    QVector<VIRTADDR> creatures = enumerate_vector(
-            m_layout->address("creature_vector") + m_memory_correction);
-    if (creatures.size() < 1) {
-        // no game loaded, or process is gone
-        emit connection_interrupted();
+    // only the creature vector's begin/end pointers and the dwarf race are
+    // read, which is enough to tell if DF is alive, has a fort loaded and
+    // whether anyone arrived or left
+    QByteArray fingerprint(12, 0);
+    QVector<ReadRequest> reads;
+    reads << ReadRequest(m_layout->address("creature_vector") +
+                         m_memory_correction + VECTOR_POINTER_OFFSET,
+                         2 * sizeof(VIRTADDR), fingerprint.data());
+    reads << ReadRequest(m_layout->address("dwarf_race_index") +
+                         m_memory_correction, 4, fingerprint.data() + 8);
+    read_batch(reads);
+
+    if (reads.at(0).bytes_read != reads.at(0).bytes) {
+        m_heartbeat_timer->stop();
+        emit process_gone();
+        return;
     }
+    MemorySpan<VIRTADDR> header(fingerprint);
+    if (header.at(0) == 0 || header.at(1) <= header.at(0)) {
+        m_heartbeat_timer->stop();
+        emit fort_unloaded();
+        return;
+    }
+
+    // back off while nothing happens, and go back to beating quickly as
+    // soon as something does
+    int interval = m_heartbeat_timer->interval();
+    if (!m_heartbeat_fingerprint.isEmpty()
+        && fingerprint != m_heartbeat_fingerprint) {
+        interval = HEARTBEAT_MIN_MSECS;
+        m_heartbeat_fingerprint = fingerprint;
+        emit creatures_changed();
+    } else {
+        interval = qMin(interval * 2, (int)HEARTBEAT_MAX_MSECS);
+        m_heartbeat_fingerprint = fingerprint;
+    }
+    m_heartbeat_timer->setInterval(interval);
 }
 
 bool DFInstance::is_valid_address(const VIRTADDR &addr) {
-    bool valid = false;
+    if (m_range_starts.isEmpty())
+        return false;
+
+    // pointers tend to come in runs into the same block, try that first
+    if (addr >= m_range_starts.at(m_last_range_hit)
+        && addr <= m_range_ends.at(m_last_range_hit))
+        return true;
+
+    // first range starting past addr, the one before it may hold addr
+    const VIRTADDR *starts = m_range_starts.constData();
+    int idx = qUpperBound(starts, starts + m_range_starts.size(), addr) - starts;
+    if (idx == 0 || addr > m_range_ends.at(idx - 1))
+        return false;
+    m_last_range_hit = idx - 1;
+    return true;
+}
+
+QVector<VIRTADDR> DFInstance::validate_pointers(const QVector<VIRTADDR> &addrs) {
+    QVector<VIRTADDR> valid;
+    valid.reserve(addrs.size());
+    foreach(VIRTADDR addr, addrs) {
+        if (is_valid_address(addr))
+            valid << addr;
+    }
+    return valid;
+}
+
+void DFInstance::build_address_index() {
+    QVector<QPair<VIRTADDR, VIRTADDR> > ranges;
+    ranges.reserve(m_regions.size());
     foreach(MemorySegment *seg, m_regions) {
-        if (seg->contains(addr)) {
-            valid = true;
-            break;
+        ranges << qMakePair(seg->start_addr, seg->end_addr);
+    }
+    qSort(ranges);
+
+    m_range_starts.clear();
+    m_range_ends.clear();
+    m_last_range_hit = 0;
+    for (int i = 0; i < ranges.size(); ++i) {
+        const QPair<VIRTADDR, VIRTADDR> &r = ranges.at(i);
+        // fold overlapping and touching segments into the previous range
+        if (!m_range_ends.isEmpty() && (r.first <= m_range_ends.last()
+                || r.first - m_range_ends.last() == 1)) {
+            m_range_ends.last() = qMax(m_range_ends.last(), r.second);
+        } else {
+            m_range_starts << r.first;
+            m_range_ends << r.second;
         }
     }
-    return valid;
+    TRACE << "address index has" << m_range_starts.size() << "ranges from"
+            << m_regions.size() << "segments";
 }
 
 QByteArray DFInstance::get_data(const VIRTADDR &addr, int size) {
@@ -560,27 +1277,20 @@ QVector<VIRTADDR> DFInstance::find_vectors_in_range(const int &max_entries,
                                                 const VIRTADDR &start_address,
                                                 const int &range_length) {
     QByteArray data = get_data(start_address, range_length);
+    MemorySpan<VIRTADDR> words(data);
     QVector<VIRTADDR> vectors;
-    VIRTADDR int1 = 0; // holds the start val
-    VIRTADDR int2 = 0; // holds the end val
 
     for (int i = 0; i < range_length; i += 4) {
-        memcpy(&int1, data.data() + i, 4);
-        memcpy(&int2, data.data() + i + 4, 4);
+        // reads past the end come back as 0, which is never valid
+        VIRTADDR int1 = words.at_offset(i); // holds the start val
+        VIRTADDR int2 = words.at_offset(i + 4); // holds the end val
         if (int2 >= int1 && is_valid_address(int1) && is_valid_address(int2)) {
             int bytes = int2 - int1;
             int entries = bytes / 4;
             if (entries > 0 && entries <= max_entries) {
                 VIRTADDR vector_addr = start_address + i - VECTOR_POINTER_OFFSET;
                 QVector<VIRTADDR> addrs = enumerate_vector(vector_addr);
-                bool all_valid = true;
-                foreach(VIRTADDR vec_entry, addrs) {
-                    if (!is_valid_address(vec_entry)) {
-                        all_valid = false;
-                        break;
-                    }
-                }
-                if (all_valid) {
+                if (validate_pointers(addrs).size() == addrs.size()) {
                     vectors << vector_addr;
                 }
             }
@@ -600,201 +1310,47 @@ QVector<VIRTADDR> DFInstance::find_vectors(int num_entries, int fuzz/* =0 */,
     | 4bytes     | 4bytes      | 4 bytes   | 4bytes
     ALLOCATOR    |START_ADDRESS|END_ADDRESS|END_ALLOCATOR
     */
-    m_stop_scan = false; //! if ever set true, bail from the inner loop
-    QVector<VIRTADDR> vectors; //! return value collection of vectors found
-    VIRTADDR int1 = 0; // holds the start val
-    VIRTADDR int2 = 0; // holds the end val
+    VectorKernel kernel(num_entries - fuzz, num_entries + fuzz, entry_size,
+                        VECTOR_POINTER_OFFSET);
+    QVector<VIRTADDR> candidates = run_scan(&kernel);
 
-    // progress reporting
-    m_scan_speed_timer->start(500);
-    m_memory_remap_timer->stop(); // don't remap segments while scanning
-    int total_bytes = 0;
-    m_bytes_scanned = 0; // for global timings
-    int bytes_scanned = 0; // for progress calcs
-    foreach(MemorySegment *seg, m_regions) {
-        total_bytes += seg->size;
-    }
-    int report_every_n_bytes = total_bytes / 1000;
-    emit scan_total_steps(1000);
-    emit scan_progress(0);
-
-    int scan_step_size = 0x10000;
-    QByteArray buffer(scan_step_size, '\0');
-    QTime timer;
-    timer.start();
+    // the workers only looked at the headers, enumerate what they found
+    QVector<VIRTADDR> vectors; //! return value collection of vectors found
     attach();
-    foreach(MemorySegment *seg, m_regions) {
-        //TRACE << "SCANNING REGION" << hex << seg->start_addr << "-"
-        //        << seg->end_addr << "BYTES:" << dec << seg->size;
-        if ((int)seg->size <= scan_step_size) {
-            scan_step_size = seg->size;
-        }
-        int scan_steps = seg->size / scan_step_size;
-        if (seg->size % scan_step_size) {
-            scan_steps++;
-        }
-        VIRTADDR addr = 0; // the ptr we will read from
-        for(int step = 0; step < scan_steps; ++step) {
-            addr = seg->start_addr + (scan_step_size * step);
-            //LOGD << "starting scan for vectors at" << hex << addr << "step"
-            //        << dec << step << "of" << scan_steps;
-            int bytes_read = read_raw(addr, scan_step_size, buffer);
-            if (bytes_read < scan_step_size) {
-                continue;
-            }
-            for(int offset = 0; offset < scan_step_size; offset += entry_size) {
-                int1 = decode_int(buffer.mid(offset, entry_size));
-                int2 = decode_int(buffer.mid(offset + entry_size, entry_size));
-                if (int1 && int2 && int2 >= int1
-                    && int1 % 4 == 0
-                    && int2 % 4 == 0
-                    //&& is_valid_address(int1)
-                    //&& is_valid_address(int2)
-                    ) {
-                    int bytes = int2 - int1;
-                    int entries = bytes / entry_size;
-                    int diff = entries - num_entries;
-                    if (qAbs(diff) <= fuzz) {
-                        VIRTADDR vector_addr = addr + offset -
-                                               VECTOR_POINTER_OFFSET;
-                        QVector<VIRTADDR> addrs = enumerate_vector(vector_addr);
-                        diff = addrs.size() - num_entries;
-                        if (qAbs(diff) <= fuzz) {
-                            vectors << vector_addr;
-                        }
-                    }
-                }
-                m_bytes_scanned += entry_size;
-                bytes_scanned += entry_size;
-                if (m_stop_scan)
-                    break;
-            }
-            emit scan_progress(bytes_scanned / report_every_n_bytes);
-            DT->processEvents();
-            if (m_stop_scan)
-                break;
+    foreach(VIRTADDR vector_addr, candidates) {
+        QVector<VIRTADDR> addrs = enumerate_vector(vector_addr);
+        int diff = addrs.size() - num_entries;
+        if (qAbs(diff) <= fuzz) {
+            vectors << vector_addr;
         }
+        if (m_stop_scan)
+            break;
     }
     detach();
-    m_memory_remap_timer->start(20000); // start the remapper again
-    m_scan_speed_timer->stop();
-    LOGD << QString("Scanned %L1MB in %L2ms").arg(bytes_scanned / 1024 * 1024)
-            .arg(timer.elapsed());
-    emit scan_progress(100);
     return vectors;
 }
 
 QVector<VIRTADDR> DFInstance::find_vectors_ext(int num_entries, const char op,
                               const uint start_addr, const uint end_addr, int entry_size/* =4 */) {
-    /*
-    glibc++ does vectors like so...
-    |4bytes      | 4bytes    | 4bytes
-    START_ADDRESS|END_ADDRESS|END_ALLOCATOR
+    // see find_vectors() for the layouts we're looking for
+    VectorKernel kernel(1, 999, entry_size, VECTOR_POINTER_OFFSET);
+    QVector<VIRTADDR> candidates = run_scan(&kernel, start_addr, end_addr);
 
-    MSVC++ does vectors like so...
-    | 4bytes     | 4bytes      | 4 bytes   | 4bytes
-    ALLOCATOR    |START_ADDRESS|END_ADDRESS|END_ALLOCATOR
-    */
-    m_stop_scan = false; //! if ever set true, bail from the inner loop
     QVector<VIRTADDR> vectors; //! return value collection of vectors found
-    VIRTADDR int1 = 0; // holds the start val
-    VIRTADDR int2 = 0; // holds the end val
-
-    // progress reporting
-    m_scan_speed_timer->start(500);
-    m_memory_remap_timer->stop(); // don't remap segments while scanning
-    int total_bytes = 0;
-    m_bytes_scanned = 0; // for global timings
-    int bytes_scanned = 0; // for progress calcs
-    foreach(MemorySegment *seg, m_regions) {
-        total_bytes += seg->size;
-    }
-    int report_every_n_bytes = total_bytes / 1000;
-    emit scan_total_steps(1000);
-    emit scan_progress(0);
-
-    int scan_step_size = 0x10000;
-    QByteArray buffer(scan_step_size, '\0');
-    QTime timer;
-    timer.start();
     attach();
-    foreach(MemorySegment *seg, m_regions) {
-        //TRACE << "SCANNING REGION" << hex << seg->start_addr << "-"
-        //        << seg->end_addr << "BYTES:" << dec << seg->size;
-        if ((int)seg->size <= scan_step_size) {
-            scan_step_size = seg->size;
-        }
-        int scan_steps = seg->size / scan_step_size;
-        if (seg->size % scan_step_size) {
-            scan_steps++;
-        }
-
-        if( seg->end_addr < start_addr ) {
+    foreach(VIRTADDR vector_addr, candidates) {
+        if (vector_addr < start_addr || vector_addr > end_addr)
             continue;
+        QVector<VIRTADDR> addrs = enumerate_vector(vector_addr);
+        if( (op == '=' && addrs.size() == num_entries)
+                || (op == '<' && addrs.size() < num_entries)
+                || (op == '>' && addrs.size() > num_entries) ) {
+            vectors << vector_addr;
         }
-
-        if( seg->start_addr > end_addr ) {
+        if (m_stop_scan)
             break;
-        }
-
-        VIRTADDR addr = 0; // the ptr we will read from
-        for(int step = 0; step < scan_steps; ++step) {
-            addr = seg->start_addr + (scan_step_size * step);
-            //LOGD << "starting scan for vectors at" << hex << addr << "step"
-            //        << dec << step << "of" << scan_steps;
-            int bytes_read = read_raw(addr, scan_step_size, buffer);
-            if (bytes_read < scan_step_size) {
-                continue;
-            }
-
-            for(int offset = 0; offset < scan_step_size; offset += entry_size) {
-                VIRTADDR vector_addr = addr + offset - VECTOR_POINTER_OFFSET;
-
-                if( vector_addr < start_addr ) {
-                    continue;
-                }
-
-                if( vector_addr > end_addr ) {
-                    m_stop_scan = true;
-                    break;
-                }
-
-                int1 = decode_int(buffer.mid(offset, entry_size));
-                int2 = decode_int(buffer.mid(offset + entry_size, entry_size));
-                if (int1 && int2 && int2 >= int1
-                    && int1 % 4 == 0
-                    && int2 % 4 == 0
-                    //&& is_valid_address(int1)
-                    //&& is_valid_address(int2)
-                    ) {
-                    int bytes = int2 - int1;
-                    int entries = bytes / entry_size;
-                    if (entries > 0 && entries < 1000) {
-                        QVector<VIRTADDR> addrs = enumerate_vector(vector_addr);
-                        if( (op == '=' && addrs.size() == num_entries)
-                                || (op == '<' && addrs.size() < num_entries)
-                                || (op == '>' && addrs.size() > num_entries) ) {
-                            vectors << vector_addr;
-                        }
-                    }
-                }
-                m_bytes_scanned += entry_size;
-                bytes_scanned += entry_size;
-                if (m_stop_scan)
-                    break;
-            }
-            emit scan_progress(bytes_scanned / report_every_n_bytes);
-            DT->processEvents();
-            if (m_stop_scan)
-                break;
-        }
     }
     detach();
-    m_memory_remap_timer->start(20000); // start the remapper again
-    m_scan_speed_timer->stop();
-    LOGD << QString("Scanned %L1MB in %L2ms").arg(bytes_scanned / 1024 * 1024)
-            .arg(timer.elapsed());
-    emit scan_progress(100);
     return vectors;
 }
 
@@ -806,6 +1362,7 @@ QVector<VIRTADDR> DFInstance::find_vectors(int num_entries, const QVector<VIRTAD
 
     // progress reporting
     m_scan_speed_timer->start(500);
+    bool remapping = m_memory_remap_timer->isActive();
     m_memory_remap_timer->stop(); // don't remap segments while scanning
 
     int total_vectors = vectors.size();
@@ -830,8 +1387,9 @@ QVector<VIRTADDR> DFInstance::find_vectors(int num_entries, const QVector<VIRTAD
 
         VIRTADDR int1 = 0; // holds the start val
         VIRTADDR int2 = 0; // holds the end val
-        int1 = decode_int(buffer.mid(VECTOR_POINTER_OFFSET, sizeof(VIRTADDR)));
-        int2 = decode_int(buffer.mid(VECTOR_POINTER_OFFSET+ sizeof(VIRTADDR), sizeof(VIRTADDR)));
+        MemorySpan<VIRTADDR> header(buffer);
+        int1 = header.at_offset(VECTOR_POINTER_OFFSET);
+        int2 = header.at_offset(VECTOR_POINTER_OFFSET + sizeof(VIRTADDR));
 
         if (int1 && int2 && int2 >= int1
                 && int1 % 4 == 0
@@ -862,7 +1420,8 @@ QVector<VIRTADDR> DFInstance::find_vectors(int num_entries, const QVector<VIRTAD
 
 
     detach();
-    m_memory_remap_timer->start(20000); // start the remapper again
+    if (remapping)
+        m_memory_remap_timer->start(); // start the remapper again
     m_scan_speed_timer->stop();
     LOGD << QString("Scanned %L1 vectors in %L2ms").arg(vectors_scanned)
             .arg(timer.elapsed());
@@ -881,7 +1440,8 @@ MemoryLayout *DFInstance::get_memory_layout(QString checksum, bool) {
 
     if(!m_is_ok) {
         LOGD << "Could not find layout for checksum" << checksum;
-        DT->get_main_window()->check_for_layout(checksum);
+        if (DT->get_main_window())
+            DT->get_main_window()->check_for_layout(checksum);
     }
 
     if (m_is_ok) {
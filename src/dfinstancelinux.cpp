@@ -25,6 +25,10 @@ THE SOFTWARE.
 #include <sys/ptrace.h>
 #include <errno.h>
 #include <wait.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "dfinstance.h"
 #include "dfinstancelinux.h"
@@ -36,16 +40,29 @@ THE SOFTWARE.
 #include "cp437codec.h"
 #include "memorysegment.h"
 #include "truncatingfilelogger.h"
+#include "dwarftherapist.h"
+#include "scanengine.h"
 
 DFInstanceLinux::DFInstanceLinux(QObject* parent)
     : DFInstance(parent)
+    , m_use_vm_readv(true)
+    , m_use_vm_writev(true)
+    , m_use_mem_pwrite(true)
+    , m_soft_dirty_ok(true)
+    , m_tracking_changes(false)
 {
+    // maps are cheap to re-read here, so we remap when a pass starts or a
+    // read faults instead of on a timer
+    m_memory_remap_timer->stop();
 }
 
 DFInstanceLinux::~DFInstanceLinux() {
     if (m_attach_count > 0) {
         detach();
     }
+    m_memory_file.close();
+    m_memory_write_file.close();
+    m_pagemap_file.close();
 }
 
 QVector<uint> DFInstanceLinux::enumerate_vector(const uint &addr) {
@@ -54,13 +71,14 @@ QVector<uint> DFInstanceLinux::enumerate_vector(const uint &addr) {
         return addrs;
 
     attach();
-    VIRTADDR start = read_addr(addr);
-    VIRTADDR end = read_addr(addr + 4);
+    VIRTADDR header[2] = {0, 0}; // start and end pointers
+    read_mem(addr, sizeof(header), header);
+    VIRTADDR start = header[0];
+    VIRTADDR end = header[1];
     int bytes = end - start;
     int entries = bytes / 4;
     TRACE << "enumerating vector at" << hex << addr << "START" << start
         << "END" << end << "UNVERIFIED ENTRIES" << dec << entries;
-    VIRTADDR tmp_addr = 0;
 
     if (entries > 5000) {
         LOGW << "vector at" << hexify(addr) << "has over 5000 entries! (" <<
@@ -83,56 +101,92 @@ QVector<uint> DFInstanceLinux::enumerate_vector(const uint &addr) {
 #endif
     QByteArray data(bytes, 0);
     int bytes_read = read_raw(start, bytes, data);
+    // when reading live DF may have grown or moved the vector while we were
+    // copying it, so go again until the header we started from still holds
+    for (int i = 0; m_live_reads && i < MAX_TORN_RETRIES; ++i) {
+        VIRTADDR check[2] = {0, 0};
+        read_mem(addr, sizeof(check), check);
+        if (check[0] == start && check[1] == end)
+            break;
+        m_torn_reads++;
+        start = check[0];
+        end = check[1];
+        bytes = end > start ? end - start : 0;
+        data = QByteArray(bytes, 0);
+        bytes_read = read_raw(start, bytes, data);
+    }
     if (bytes_read != bytes && m_layout->is_complete()) {
         LOGW << "Tried to read" << bytes << "bytes but only got"
                 << bytes_read;
         detach();
         return addrs;
     }
-    for(int i = 0; i < bytes; i += 4) {
-        tmp_addr = decode_dword(data.mid(i, 4));
-        if (m_layout->is_complete()) {
-            if (is_valid_address(tmp_addr))
-                addrs << tmp_addr;
-        } else {
-            addrs << tmp_addr;
-        }
+    MemorySpan<VIRTADDR>(data).append_to(addrs);
+    if (m_layout->is_complete()) {
+        addrs = validate_pointers(addrs);
     }
     detach();
     return addrs;
 }
 
 uint DFInstanceLinux::calculate_checksum() {
+    return checksum_of(m_pid);
+}
+
+uint DFInstanceLinux::checksum_of(int pid) {
     // ELF binaries don't seem to store a linker timestamp, so just MD5 the file.
-    uint md5 = 0; // we're going to throw away a lot of this checksum we just need 4bytes worth
-    QProcess *proc = new QProcess(this);
-    QStringList args;
-    args << "md5sum";
-    args << QString("/proc/%1/exe").arg(m_pid);
-    proc->start("/usr/bin/env", args);
-    if (proc->waitForReadyRead(3000)) {
-        QByteArray out = proc->readAll();
-        QString str_md5(out);
-        QStringList chunks = str_md5.split(" ");
-        str_md5 = chunks[0];
-        bool ok;
-        md5 = str_md5.mid(0, 8).toUInt(&ok,16); // use the first 8 bytes
-        TRACE << "GOT MD5:" << md5;
+    QString exe = QString("/proc/%1/exe").arg(pid);
+    struct stat info;
+    if (stat(qPrintable(exe), &info) != 0) {
+        LOGE << "unable to stat" << exe;
+        return 0;
+    }
+
+    // hashing a multi-megabyte binary on every connect (and in every scanner
+    // job) adds up, so remember what we got for this exact file
+    QString key = QString("checksums/%1-%2-%3-%4")
+                  .arg((qulonglong)info.st_dev).arg((qulonglong)info.st_ino)
+                  .arg((qulonglong)info.st_size).arg((qulonglong)info.st_mtime);
+    // our own QSettings, scanner jobs call this from worker threads
+    QSettings s(QSettings::IniFormat, QSettings::UserScope, COMPANY, PRODUCT);
+    bool ok = false;
+    uint md5 = s.value(key).toString().toUInt(&ok, 16);
+    if (ok) {
+        TRACE << "CACHED MD5:" << hexify(md5);
+        return md5;
+    }
+
+    QFile f(exe);
+    if (!f.open(QIODevice::ReadOnly)) {
+        LOGE << "unable to open" << exe << f.errorString();
+        return 0;
     }
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    uchar *data = f.map(0, f.size());
+    if (data) {
+        // feed the mapping through in slices so we only fault in a bit at a time
+        static const qint64 slice = 1 << 20;
+        for (qint64 pos = 0; pos < f.size(); pos += slice) {
+            hash.addData((const char*)data + pos, qMin(slice, f.size() - pos));
+        }
+        f.unmap(data);
+    } else {
+        while (!f.atEnd()) {
+            hash.addData(f.read(1 << 20));
+        }
+    }
+    f.close();
+
+    // we're going to throw away a lot of this checksum we just need 4bytes worth
+    md5 = qFromBigEndian<quint32>((const uchar*)hash.result().constData());
+    TRACE << "GOT MD5:" << hexify(md5);
+    s.setValue(key, QString::number(md5, 16));
     return md5;
 }
 
 
 QString DFInstanceLinux::read_string(const VIRTADDR &addr) {
-    VIRTADDR buffer_addr = read_addr(addr);
-    int upper_size = 256;
-    QByteArray buf(upper_size, 0);
-    read_raw(buffer_addr, upper_size, buf);
-
-    QString ret_val(buf);
-    CP437Codec *codec = new CP437Codec;
-    ret_val = codec->toUnicode(ret_val.toAscii());
-    return ret_val;
+    return read_libstdcxx_string(addr);
 }
 
 int DFInstanceLinux::write_string(const VIRTADDR &addr, const QString &str) {
@@ -153,6 +207,40 @@ bool DFInstanceLinux::attach() {
         return true;
     }
 
+    // live reads leave DF running, /proc/<pid>/mem and process_vm_readv
+    // only need us to be allowed to trace it, not to have it stopped
+    if (!m_live_reads && !stop_process()) {
+        return false;
+    }
+    m_attach_count++;
+    TRACE << "FINISHED ATTACH" << m_attach_count;
+    return m_attach_count > 0;
+}
+
+bool DFInstanceLinux::detach() {
+    TRACE << "STARTING DETACH" << m_attach_count;
+    if (m_attach_count <= 0) {
+        // the matching attach() failed, there's nothing to undo
+        LOGW << "detach without a successful attach, ignoring";
+        m_attach_count = 0;
+        return false;
+    }
+    m_attach_count--;
+    if (m_attach_count > 0) {
+        TRACE << "NO NEED TO DETACH SKIPPING..." << m_attach_count;
+        return true;
+    }
+
+    if (!m_live_reads) {
+        resume_process();
+    }
+    // DF is free to run again, nothing we cached is trustworthy anymore
+    drop_read_cache();
+    TRACE << "FINISHED DETACH" << m_attach_count;
+    return m_attach_count > 0;
+}
+
+bool DFInstanceLinux::stop_process() {
     if (ptrace(PTRACE_ATTACH, m_pid, 0, 0) == -1) { // unable to attach
         perror("ptrace attach");
         LOGE << "Could not attach to PID" << m_pid;
@@ -173,62 +261,134 @@ bool DFInstanceLinux::attach() {
         }
         TRACE << "waitpid returned but child wasn't stopped, keep waiting...";
     }
-    m_attach_count++;
-    TRACE << "FINISHED ATTACH" << m_attach_count;
-    return m_attach_count > 0;
+    return true;
 }
 
-bool DFInstanceLinux::detach() {
-    TRACE << "STARTING DETACH" << m_attach_count;
-    m_attach_count--;
-    if (m_attach_count > 0) {
-        TRACE << "NO NEED TO DETACH SKIPPING..." << m_attach_count;
+void DFInstanceLinux::resume_process() {
+    ptrace(PTRACE_DETACH, m_pid, 0, 0);
+}
+
+bool DFInstanceLinux::open_memory_file() {
+    if (m_memory_file.isOpen())
         return true;
+    m_memory_file.setFileName(QString("/proc/%1/mem").arg(m_pid));
+    // unbuffered, since every read is a positional pread() on the handle
+    if (!m_memory_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        LOGE << "Unable to open" << m_memory_file.fileName()
+                << m_memory_file.errorString();
+        return false;
     }
-
-    ptrace(PTRACE_DETACH, m_pid, 0, 0);
-    TRACE << "FINISHED DETACH" << m_attach_count;
-    return m_attach_count > 0;
+    TRACE << "opened" << m_memory_file.fileName();
+    return true;
 }
 
 int DFInstanceLinux::read_raw(const VIRTADDR &addr, int bytes, QByteArray &buffer) {
+    buffer.resize(bytes);
+    return read_mem(addr, bytes, buffer.data());
+}
+
+int DFInstanceLinux::read_remote(const VIRTADDR &addr, int bytes, void *buffer) {
+    char *out = static_cast<char*>(buffer);
+    memset(out, 0, bytes);
+
     // try to attach, will be ignored if we're already attached
     attach();
-
-    // open the memory virtual file for this proc (can only read once
-    // attached and child is stopped
-    QFile mem_file(QString("/proc/%1/mem").arg(m_pid));
-    if (!mem_file.open(QIODevice::ReadOnly)) {
-        LOGE << "Unable to open" << mem_file.fileName();
+    if (!open_memory_file()) {
         detach();
         return 0;
     }
-    int bytes_read = 0; // tracks how much we've read of what was asked for
-    int step_size = 0x1000; // how many bytes to read each step
-    QByteArray chunk(step_size, 0); // our temporary memory container
-    buffer.fill(0, bytes); // zero our buffer
-    int steps = bytes / step_size;
-    if (bytes % step_size)
-        steps++;
+    int fd = m_memory_file.handle();
 
-    for(VIRTADDR ptr = addr; ptr < addr+ bytes; ptr += step_size) {
-        if (ptr+step_size > addr + bytes)
-            step_size = addr + bytes - ptr;
-        mem_file.seek(ptr);
-        chunk = mem_file.read(step_size);
-        buffer.replace(bytes_read, chunk.size(), chunk);
-        bytes_read += chunk.size();
+    int bytes_read = 0; // tracks how much we've read of what was asked for
+    quint64 ptr = addr;
+    quint64 end = (quint64)addr + bytes;
+    while (ptr < end) {
+        ssize_t got = pread64(fd, out + (ptr - addr), end - ptr, (off64_t)ptr);
+        if (got > 0) {
+            bytes_read += got;
+            ptr += got;
+        } else if (got == -1 && errno == EINTR) {
+            continue;
+        } else {
+            // unreadable page, leave it zeroed and carry on at the next one.
+            // Our idea of what's mapped may be stale, so remap next time
+            request_remap();
+            ptr = (ptr & ~0xfffULL) + 0x1000;
+        }
     }
-    mem_file.close();
     detach();
     return bytes_read;
 }
 
+int DFInstanceLinux::read_remote_batch(QVector<ReadRequest> &requests) {
+    // the kernel caps a single process_vm_readv at UIO_MAXIOV segments
+    static const int max_iov = 1024;
+
+    attach();
+    int total = 0;
+    for (int first = 0; first < requests.size(); first += max_iov) {
+        int count = qMin(max_iov, requests.size() - first);
+        QVarLengthArray<struct iovec, 64> local(count);
+        QVarLengthArray<struct iovec, 64> remote(count);
+        for (int i = 0; i < count; ++i) {
+            ReadRequest &r = requests[first + i];
+            memset(r.buffer, 0, r.bytes);
+            local[i].iov_base = r.buffer;
+            local[i].iov_len = r.bytes;
+            remote[i].iov_base = (void*)(quintptr)r.addr;
+            remote[i].iov_len = r.bytes;
+        }
+
+        ssize_t got = -1;
+        if (m_use_vm_readv) {
+            got = process_vm_readv(m_pid, local.data(), count, remote.data(),
+                                   count, 0);
+            if (got == -1 && errno == ENOSYS) {
+                LOGI << "process_vm_readv is not available, falling back to"
+                        << "reading /proc/" << m_pid << "/mem";
+                m_use_vm_readv = false;
+            }
+        }
+        if (got < 0)
+            got = 0;
+
+        // process_vm_readv stops at the first segment it can't read, so
+        // anything it didn't get gets a second chance through pread
+        for (int i = 0; i < count; ++i) {
+            ReadRequest &r = requests[first + i];
+            if (got >= r.bytes) {
+                r.bytes_read = r.bytes;
+                got -= r.bytes;
+            } else {
+                got = 0;
+                r.bytes_read = read_remote(r.addr, r.bytes, r.buffer);
+            }
+            total += r.bytes_read;
+        }
+    }
+    detach();
+    return total;
+}
+
 int DFInstanceLinux::write_raw(const VIRTADDR &addr, const int &bytes,
                                void *buffer) {
     // try to attach, will be ignored if we're already attached
     attach();
+    // POKEDATA needs a stopped tracee even when we're otherwise reading live
+    bool stopped_for_write = m_live_reads && stop_process();
+    int bytes_written = poke_words(addr, bytes, static_cast<char*>(buffer));
+    invalidate_cached_range(addr, bytes);
+    if (stopped_for_write) {
+        resume_process();
+    }
+    // attempt to detach, will be ignored if we're several layers into an attach chain
+    detach();
+    // tell the caller how many bytes we wrote
+    return bytes_written;
+}
 
+int DFInstanceLinux::poke_words(const VIRTADDR &addr, int bytes,
+                                const char *buffer) {
     /* Since most kernels won't let us write to /proc/<pid>/mem, we have to poke
      * out data in n bytes at a time. Good thing we read way more than we write.
      *
@@ -244,65 +404,309 @@ int DFInstanceLinux::write_raw(const VIRTADDR &addr, const int &bytes,
     uint steps = bytes / stepsize;
     if (bytes % stepsize)
         steps++;
-    LOGD << "WRITE_RAW: WILL WRITE" << bytes << "bytes over" << steps << "steps, with stepsize " << stepsize;
+    TRACE << "POKE_WORDS:" << bytes << "bytes over" << steps << "steps";
 
     // we want to make sure that given the case where (bytes % stepsize != 0) we don't
     // clobber data past where we meant to write. So we're first going to read
     // the existing data as it is, and then write the changes over the existing
-    // data in the buffer first, then write the buffer with stepsize bytes at a time 
+    // data in the buffer first, then write the buffer with stepsize bytes at a time
     // to the process. This should ensure no clobbering of data.
     QByteArray existing_data(steps * stepsize, 0);
-    read_raw(addr, (steps * stepsize), existing_data);
-    LOGD << "WRITE_RAW: EXISTING OLD DATA     " << existing_data.toHex();
-
-    // ok we have our insurance in place, now write our new junk to the buffer
+    read_remote(addr, steps * stepsize, existing_data.data());
     memcpy(existing_data.data(), buffer, bytes);
-    QByteArray tmp2(existing_data);
-    LOGD << "WRITE_RAW: EXISTING WITH NEW DATA" << tmp2.toHex();
 
-    // ok, now our to be written data is in part or all of the exiting data buffer
+    const char *words = existing_data.constData();
     long tmp_data;
     for (uint i = 0; i < steps; ++i) {
         int offset = i * stepsize;
         // for each step write a single word to the child
-        memcpy(&tmp_data, existing_data.mid(offset, stepsize).data(), stepsize);
-        QByteArray tmp_data_str((char*)&tmp_data, stepsize);
-        LOGD << "WRITE_RAW:" << hex << addr + offset << "HEX" << tmp_data_str.toHex();
+        memcpy(&tmp_data, words + offset, stepsize);
         if (ptrace(PTRACE_POKEDATA, m_pid, addr + offset, tmp_data) != 0) {
             perror("write word");
             break;
         } else {
             bytes_written += stepsize;
         }
-        long written = ptrace(PTRACE_PEEKDATA, m_pid, addr + offset, 0);
-        QByteArray foo((char*)&written, stepsize);
-        LOGD << "WRITE_RAW: WE APPEAR TO HAVE WRITTEN" << foo.toHex();
     }
-    // attempt to detach, will be ignored if we're several layers into an attach chain
+    return qMin((int)bytes_written, bytes);
+}
+
+int DFInstanceLinux::write_remote_batch(QVector<ReadRequest> &writes) {
+    static const int max_iov = 1024;
+
+    attach();
+    // everything goes out in one stop window so DF never sees half a plan
+    bool stopped_for_write = m_live_reads && stop_process();
+    for (int i = 0; i < writes.size(); ++i)
+        writes[i].bytes_read = 0;
+
+    // process_vm_writev first, it doesn't care about the tracee's state and
+    // does a whole plan in a syscall or two
+    for (int first = 0; m_use_vm_writev && first < writes.size();
+         first += max_iov) {
+        int count = qMin(max_iov, writes.size() - first);
+        QVarLengthArray<struct iovec, 64> local(count);
+        QVarLengthArray<struct iovec, 64> remote(count);
+        for (int i = 0; i < count; ++i) {
+            ReadRequest &w = writes[first + i];
+            local[i].iov_base = w.buffer;
+            local[i].iov_len = w.bytes;
+            remote[i].iov_base = (void*)(quintptr)w.addr;
+            remote[i].iov_len = w.bytes;
+        }
+        ssize_t put = process_vm_writev(m_pid, local.data(), count,
+                                        remote.data(), count, 0);
+        if (put == -1 && errno == ENOSYS) {
+            LOGI << "process_vm_writev is not available";
+            m_use_vm_writev = false;
+        }
+        for (int i = 0; i < count && put > 0; ++i) {
+            ReadRequest &w = writes[first + i];
+            w.bytes_read = qMin((ssize_t)w.bytes, put);
+            put -= w.bytes_read;
+        }
+    }
+
+    // anything left (read-only mappings, mostly) gets pwrite on
+    // /proc/<pid>/mem, which can write through page protections, and
+    // finally POKEDATA
+    if (m_use_mem_pwrite && !m_memory_write_file.isOpen()) {
+        m_memory_write_file.setFileName(QString("/proc/%1/mem").arg(m_pid));
+        if (!m_memory_write_file.open(QIODevice::ReadWrite |
+                                      QIODevice::Unbuffered)) {
+            LOGI << "unable to open" << m_memory_write_file.fileName()
+                    << "for writing, using POKEDATA";
+            m_use_mem_pwrite = false;
+        }
+    }
+    for (int i = 0; i < writes.size(); ++i) {
+        ReadRequest &w = writes[i];
+        if (w.bytes_read == w.bytes)
+            continue;
+        if (m_use_mem_pwrite) {
+            ssize_t put = pwrite64(m_memory_write_file.handle(), w.buffer,
+                                   w.bytes, (off64_t)w.addr);
+            if (put == w.bytes) {
+                w.bytes_read = w.bytes;
+                continue;
+            }
+            if (put == -1 && (errno == EPERM || errno == EACCES ||
+                              errno == EINVAL)) {
+                LOGI << "this kernel won't let us write /proc/"
+                        << m_pid << "/mem, using POKEDATA";
+                m_use_mem_pwrite = false;
+            }
+        }
+        if (!m_live_reads || stopped_for_write) {
+            w.bytes_read = poke_words(w.addr, w.bytes,
+                                      static_cast<char*>(w.buffer));
+        }
+    }
+
+    int total = 0;
+    for (int i = 0; i < writes.size(); ++i) {
+        invalidate_cached_range(writes.at(i).addr, writes.at(i).bytes);
+        total += writes.at(i).bytes_read;
+    }
+    if (stopped_for_write) {
+        resume_process();
+    }
     detach();
-    // tell the caller how many bytes we wrote
-    return bytes_written;
+    return total;
+}
+
+bool DFInstanceLinux::start_change_tracking() {
+    m_tracking_changes = false;
+    // DF keeps running between our reads and the clear when reading live,
+    // anything it wrote in that window would be missed
+    if (!m_soft_dirty_ok || m_live_reads)
+        return false;
+
+    // writing 4 clears the soft-dirty bit on every page of the process
+    QFile clear_refs(QString("/proc/%1/clear_refs").arg(m_pid));
+    if (!clear_refs.open(QIODevice::WriteOnly) || clear_refs.write("4") != 1) {
+        LOGI << "unable to clear soft-dirty bits, change tracking is off"
+                << clear_refs.errorString();
+        m_soft_dirty_ok = false;
+        return false;
+    }
+    if (!open_pagemap_file()) {
+        LOGI << "change tracking is off";
+        m_soft_dirty_ok = false;
+        return false;
+    }
+    m_tracking_changes = true;
+    return true;
+}
+
+//! each scan worker preads through its own /proc/<pid>/mem descriptor
+class ProcMemScanReader : public ScanReader {
+public:
+    ProcMemScanReader(int pid)
+        : m_fd(open(qPrintable(QString("/proc/%1/mem").arg(pid)), O_RDONLY))
+    {}
+    ~ProcMemScanReader() {
+        if (m_fd != -1)
+            close(m_fd);
+    }
+    int read(const VIRTADDR &addr, int bytes, char *buffer) {
+        memset(buffer, 0, bytes);
+        if (m_fd == -1)
+            return 0;
+        int bytes_read = 0;
+        quint64 ptr = addr;
+        quint64 end = (quint64)addr + bytes;
+        while (ptr < end) {
+            ssize_t got = pread64(m_fd, buffer + (ptr - addr), end - ptr,
+                                  (off64_t)ptr);
+            if (got > 0) {
+                bytes_read += got;
+                ptr += got;
+            } else if (got == -1 && errno == EINTR) {
+                continue;
+            } else {
+                ptr = (ptr & ~0xfffULL) + 0x1000; // leave the page zeroed
+            }
+        }
+        return bytes_read;
+    }
+private:
+    int m_fd;
+};
+
+ScanReader *DFInstanceLinux::new_scan_reader() {
+    return new ProcMemScanReader(m_pid);
+}
+
+bool DFInstanceLinux::open_pagemap_file() {
+    if (m_pagemap_file.isOpen())
+        return true;
+    m_pagemap_file.setFileName(QString("/proc/%1/pagemap").arg(m_pid));
+    if (!m_pagemap_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        LOGI << "unable to open" << m_pagemap_file.fileName()
+                << m_pagemap_file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QBitArray DFInstanceLinux::resident_pages(const VIRTADDR &start,
+                                          const VIRTADDR &end) {
+    int pages = (end - start + 0xfff) / 0x1000;
+    QBitArray resident(pages, true);
+    if (!open_pagemap_file())
+        return resident;
+
+    // bit 63 is set for pages in RAM and bit 62 for swapped out ones, a
+    // page with neither has never been touched
+    static const quint64 in_use = Q_UINT64_C(3) << 62;
+    int fd = m_pagemap_file.handle();
+    QVarLengthArray<quint64, 512> entries(512);
+    for (int first = 0; first < pages; first += entries.size()) {
+        int count = qMin(entries.size(), pages - first);
+        off64_t offset = (off64_t)(start / 0x1000 + first) * sizeof(quint64);
+        ssize_t got = pread64(fd, entries.data(), count * sizeof(quint64),
+                              offset);
+        if (got != (ssize_t)(count * sizeof(quint64)))
+            break; // leave the rest marked resident and let reads sort it out
+        for (int i = 0; i < count; ++i) {
+            if (!(entries[i] & in_use))
+                resident.clearBit(first + i);
+        }
+    }
+    return resident;
+}
+
+bool DFInstanceLinux::pages_changed(const QVector<VIRTADDR> &pages) {
+    if (!m_tracking_changes)
+        return true;
+    // pagemap holds one 64-bit entry per page, bit 55 is soft-dirty
+    static const quint64 soft_dirty = Q_UINT64_C(1) << 55;
+    int fd = m_pagemap_file.handle();
+    foreach(VIRTADDR page, pages) {
+        quint64 entry = 0;
+        off64_t offset = (off64_t)(page / 0x1000) * sizeof(entry);
+        if (pread64(fd, &entry, sizeof(entry), offset) != sizeof(entry)
+            || (entry & soft_dirty)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int DFInstanceLinux::s_chosen_pid = 0;
+
+QList<int> DFInstanceLinux::find_df_pids() {
+    QList<int> pids;
+    QDir proc("/proc");
+    foreach(QString entry, proc.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        bool ok = false;
+        int pid = entry.toInt(&ok);
+        if (!ok)
+            continue;
+        QFile comm(QString("/proc/%1/comm").arg(pid));
+        if (!comm.open(QIODevice::ReadOnly))
+            continue; // gone already, or not ours to look at
+        QByteArray name = comm.readAll().trimmed();
+        if (name == "dwarfort.exe" // 0.31.04 and earlier
+            || name == "Dwarf_Fortress") { // 0.31.05+
+            pids << pid;
+        }
+    }
+    qSort(pids);
+    return pids;
+}
+
+int DFInstanceLinux::choose_df_pid(const QList<int> &pids) {
+    if (pids.size() == 1)
+        return pids.at(0);
+    if (pids.contains(s_chosen_pid))
+        return s_chosen_pid;
+
+    QStringList choices;
+    foreach(int pid, pids) {
+        QString checksum = hexify(checksum_of(pid)).toLower();
+        MemoryLayout *layout = m_memory_layouts.value(checksum, 0);
+        QString dir = QFileInfo(QString("/proc/%1/cwd").arg(pid)).symLinkTarget();
+        choices << tr("%1 - %2 (%3) in %4").arg(pid).arg(checksum)
+                   .arg(layout ? layout->game_version() : tr("unknown version"))
+                   .arg(dir);
+        LOGI << "found DF" << choices.last();
+    }
+
+    int choice = 0;
+    // scanner jobs connect from worker threads, they just take the first
+    if (QThread::currentThread() == qApp->thread() && !DT->headless()) {
+        bool ok = false;
+        QString picked = QInputDialog::getItem(0, tr("Connect to Dwarf Fortress"),
+            tr("More than one copy of Dwarf Fortress is running, which one "
+               "should Dwarf Therapist connect to?"), choices, 0, false, &ok);
+        if (ok)
+            choice = qMax(0, choices.indexOf(picked));
+    }
+    s_chosen_pid = pids.at(choice);
+    return s_chosen_pid;
 }
 
 bool DFInstanceLinux::find_running_copy(bool connect_anyway) {
     // find PID of DF
     TRACE << "attempting to find running copy of DF by executable name";
-    QProcess *proc = new QProcess(this);
-    QStringList args;
-    args << "dwarfort.exe"; // 0.31.04 and earlier
-    args << "Dwarf_Fortress"; // 0.31.05+
-    proc->start("pidof", args);
-    proc->waitForFinished(1000);
-    if (proc->exitCode() == 0) { //found it
-        QByteArray out = proc->readAllStandardOutput();
-        QString str_pid(out);
-        m_pid = str_pid.toInt();
-        m_memory_file.setFileName(QString("/proc/%1/mem").arg(m_pid));
+    QList<int> pids = find_df_pids();
+    if (!pids.isEmpty()) { //found it
+        m_pid = choose_df_pid(pids);
         TRACE << "FOUND PID:" << m_pid;
+        open_memory_file();
+        m_live_reads = DT->user_settings()->value("options/live_reads",
+                                                  false).toBool();
+        if (m_live_reads) {
+            LOGI << "reading from DF without stopping it";
+        }
     } else {
-        QMessageBox::warning(0, tr("Warning"),
-            tr("Unable to locate a running copy of Dwarf "
-            "Fortress, are you sure it's running?"));
+        if (!DT->headless()) {
+            QMessageBox::warning(0, tr("Warning"),
+                tr("Unable to locate a running copy of Dwarf "
+                "Fortress, are you sure it's running?"));
+        }
         LOGW << "can't find running copy";
         m_is_ok = false;
         return m_is_ok;
@@ -337,15 +741,39 @@ bool DFInstanceLinux::find_running_copy(bool connect_anyway) {
     return m_is_ok || connect_anyway;
 }
 
-void DFInstanceLinux::map_virtual_memory() {
-    // destroy existing segments
-    foreach(MemorySegment *seg, m_regions) {
-        delete(seg);
+/*! Parse a hex number out of a maps line, advancing pos past it */
+static quint64 parse_hex(const char *line, int &pos) {
+    quint64 val = 0;
+    for (;; ++pos) {
+        char c = line[pos];
+        if (c >= '0' && c <= '9')
+            val = (val << 4) | (c - '0');
+        else if (c >= 'a' && c <= 'f')
+            val = (val << 4) | (c - 'a' + 10);
+        else
+            return val;
     }
-    m_regions.clear();
+}
+
+static void skip_field(const char *line, int &pos) {
+    while (line[pos] && line[pos] != ' ')
+        ++pos;
+    while (line[pos] == ' ')
+        ++pos;
+}
 
-    if (!m_is_ok)
+/*! Reads /proc/<pid>/maps and brings m_regions up to date. Segments that
+    are still mapped the same way keep their MemorySegment, so only what
+    DF actually mapped or unmapped since last time gets touched. */
+void DFInstanceLinux::map_virtual_memory() {
+    if (!m_is_ok) {
+        foreach(MemorySegment *seg, m_regions) {
+            delete(seg);
+        }
+        m_regions.clear();
+        build_address_index();
         return;
+    }
 
     // scan the maps to populate known regions of memory
     QFile f(QString("/proc/%1/maps").arg(m_pid));
@@ -354,56 +782,63 @@ void DFInstanceLinux::map_virtual_memory() {
         return;
     }
     TRACE << "opened" << f.fileName();
-    QByteArray line;
+
+    QHash<quint64, MemorySegment*> old_segments; // (start << 32 | end)->segment
+    foreach(MemorySegment *seg, m_regions) {
+        old_segments.insert((quint64)seg->start_addr << 32 | seg->end_addr, seg);
+    }
+    m_regions.clear();
     m_lowest_address = 0xFFFFFFFF;
     m_highest_address = 0;
-    uint start_addr = 0;
-    uint end_addr = 0;
-    bool ok;
-
-    QRegExp rx("^([a-f\\d]+)-([a-f\\d]+)\\s([rwxsp-]{4})\\s+[\\d\\w]{8}\\s+[\\d\\w]{2}:[\\d\\w]{2}\\s+(\\d+)\\s*(.+)\\s*$");
-    do {
-        line = f.readLine();
-        // parse the first line to see find the base
-        if (rx.indexIn(line) != -1) {
-            //LOGD << "RANGE" << rx.cap(1) << "-" << rx.cap(2) << "PERMS" <<
-            //        rx.cap(3) << "INODE" << rx.cap(4) << "PATH" << rx.cap(5);
-            start_addr = rx.cap(1).toUInt(&ok, 16);
-            end_addr = rx.cap(2).toUInt(&ok, 16);
-            QString perms = rx.cap(3).trimmed();
-            int inode = rx.cap(4).toInt();
-            QString path = rx.cap(5).trimmed();
-
-            //LOGD << "RANGE" << hex << start_addr << "-" << end_addr << perms
-            //        << inode << "PATH >" << path << "<";
-            bool keep_it = false;
-            if (path.contains("[heap]") || path.contains("[stack]") || path.contains("[vdso]"))  {
-                keep_it = true;
-            } else if (perms.contains("r") && inode && path == QFile::symLinkTarget(QString("/proc/%1/exe").arg(m_pid))) {
-                keep_it = true;
-            } else {
-                keep_it = path.isEmpty();
-            }
-            // uncomment to search HEAP only
-            //keep_it = path.contains("[heap]");
-            keep_it = true;
-
-            if (keep_it && end_addr > start_addr) {
-                MemorySegment *segment = new MemorySegment(path, start_addr, end_addr);
-                TRACE << "keeping" << segment->to_string();
-                m_regions << segment;
-                if (start_addr < m_lowest_address)
-                    m_lowest_address = start_addr;
-                else if (end_addr > m_highest_address)
-                    m_highest_address = end_addr;
-            }
-            if (path.contains("[heap]")) {
-                //LOGD << "setting heap start address at" << hex << start_addr;
-                m_heap_start_address = start_addr;
-            }
+    int kept = 0;
+    QString exe = QFileInfo(QString("/proc/%1/exe").arg(m_pid)).symLinkTarget();
+
+    // each line is "start-end perms offset dev inode    path"
+    char line[1024];
+    qint64 len;
+    while ((len = f.readLine(line, sizeof(line))) > 0) {
+        if (line[len - 1] == '\n')
+            line[--len] = 0;
+        int pos = 0;
+        quint64 start = parse_hex(line, pos);
+        if (line[pos++] != '-')
+            continue;
+        quint64 end = parse_hex(line, pos);
+        skip_field(line, pos); // perms
+        skip_field(line, pos); // offset
+        skip_field(line, pos); // dev
+        skip_field(line, pos); // inode
+        if (end <= start || end > 0xFFFFFFFFULL)
+            continue; // nothing a 32bit DF can point at
+        QString path = QString::fromLocal8Bit(line + pos).trimmed();
+
+        quint64 key = start << 32 | end;
+        MemorySegment *segment = old_segments.take(key);
+        if (segment && segment->name == path) {
+            kept++;
+        } else {
+            delete segment;
+            segment = new MemorySegment(path, start, end);
+            if (!exe.isEmpty() && path == exe)
+                segment->type = MemorySegment::SEG_EXE;
+            TRACE << "keeping" << segment->to_string();
+        }
+        m_regions << segment;
+        if (start < m_lowest_address)
+            m_lowest_address = start;
+        if (end > m_highest_address)
+            m_highest_address = end;
+        if (segment->is_heap) {
+            m_heap_start_address = start;
         }
-    } while (!line.isEmpty());
+    }
     f.close();
+
+    // whatever is left over was unmapped since the last pass
+    qDeleteAll(old_segments);
+    TRACE << "remapped" << m_regions.size() << "segments," << kept
+            << "unchanged," << old_segments.size() << "gone";
+    build_address_index();
 }
 
 bool DFInstance::authorize() {
@@ -85,7 +85,6 @@ QVector<uint> DFInstanceOSX::enumerate_vector(const uint &addr) {
     int bytes = end - start;
     int entries = bytes / 4;
     TRACE << "enumerating vector at" << hex << addr << "START" << start << "END" << end << "UNVERIFIED ENTRIES" << dec << entries;
-    VIRTADDR tmp_addr = 0;
 
     if (entries > 5000) {
         LOGW << "vector at" << hexify(addr) << "has over 5000 entries! (" << entries << ")";
@@ -97,29 +96,16 @@ QVector<uint> DFInstanceOSX::enumerate_vector(const uint &addr) {
         TRACE << "Tried to read" << bytes << "bytes but only got" << bytes_read;
         return addrs;
     }
-    for(int i = 0; i < bytes; i += 4) {
-        tmp_addr = decode_dword(data.mid(i, 4));
-        if (m_layout->is_complete()) {
-            if (is_valid_address(tmp_addr))
-                addrs << tmp_addr;
-        } else {
-            addrs << tmp_addr;
-        }
+    MemorySpan<VIRTADDR>(data).append_to(addrs);
+    if (m_layout->is_complete()) {
+        addrs = validate_pointers(addrs);
     }
     detach();
     return addrs;
 }
 
 QString DFInstanceOSX::read_string(const uint &addr) {
-    VIRTADDR buffer_addr = read_addr(addr);
-    int upper_size = 256;
-    QByteArray buf(upper_size, 0);
-    read_raw(buffer_addr, upper_size, buf);
-
-    QString ret_val(buf);
-    CP437Codec *codec = new CP437Codec;
-    ret_val = codec->toUnicode(ret_val.toAscii());
-    return ret_val;
+    return read_libstdcxx_string(addr);
 }
 
 int DFInstanceOSX::write_string(const uint &addr, const QString &str) {
@@ -294,6 +280,7 @@ void DFInstanceOSX::map_virtual_memory() {
             address = address + size;
         } while (result != KERN_INVALID_ADDRESS);
         LOGD << "Mapped " << m_regions.size() << " memory regions.";
+        build_address_index();
     }
 }
 
@@ -0,0 +1,328 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <QtGui>
+#include <QtDebug>
+#include "dfinstance.h"
+#include "dfinstancesnapshot.h"
+#include "dwarftherapist.h"
+#include "defines.h"
+#include "utils.h"
+#include "memorylayout.h"
+#include "cp437codec.h"
+#include "scanengine.h"
+#include "memorysegment.h"
+#include "truncatingfilelogger.h"
+
+const char *DFInstanceSnapshot::MAGIC = "DTMEMSNP";
+
+quint32 DFInstanceSnapshot::platform_id() {
+#ifdef Q_WS_WIN
+    return 1;
+#else
+#ifdef Q_WS_MAC
+    return 2;
+#else
+    return 3;
+#endif
+#endif
+}
+
+DFInstanceSnapshot::DFInstanceSnapshot(const QString &filename, QObject *parent)
+    : DFInstance(parent)
+    , m_file(filename)
+    , m_map(0)
+{
+    // nothing in a snapshot ever moves
+    m_memory_remap_timer->stop();
+}
+
+DFInstanceSnapshot::~DFInstanceSnapshot() {
+    foreach(MemorySegment *seg, m_regions) {
+        delete(seg);
+    }
+    m_regions.clear();
+    if (m_map)
+        m_file.unmap(m_map);
+    m_file.close();
+}
+
+static quint32 snapshot_u32(const uchar *p) {
+    return qFromLittleEndian<quint32>(p);
+}
+
+bool DFInstanceSnapshot::load() {
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        LOGE << "Unable to open snapshot" << m_file.fileName();
+        return false;
+    }
+    qint64 file_size = m_file.size();
+    if (file_size < HEADER_SIZE) {
+        LOGE << m_file.fileName() << "is too small to be a snapshot";
+        return false;
+    }
+    m_map = m_file.map(0, file_size);
+    if (!m_map) {
+        LOGE << "Unable to map snapshot" << m_file.fileName()
+                << m_file.errorString();
+        return false;
+    }
+
+    const uchar *p = m_map;
+    if (memcmp(p, MAGIC, 8) != 0) {
+        LOGE << m_file.fileName() << "is not a memory snapshot";
+        return false;
+    }
+    quint32 version = snapshot_u32(p + 8);
+    quint32 platform = snapshot_u32(p + 12);
+    if (version != FORMAT_VERSION && version != 1) {
+        LOGE << "snapshot version" << version << "is not supported";
+        return false;
+    }
+    if (platform != platform_id()) {
+        LOGE << "snapshot was captured on platform" << platform
+                << "and can't be replayed here";
+        return false;
+    }
+    m_pid = snapshot_u32(p + 16);
+    m_base_addr = snapshot_u32(p + 20);
+    m_lowest_address = snapshot_u32(p + 24);
+    m_highest_address = snapshot_u32(p + 28);
+    m_heap_start_address = snapshot_u32(p + 32);
+    m_memory_correction = snapshot_u32(p + 36);
+    quint32 segment_count = snapshot_u32(p + 40);
+    quint32 strings_size = snapshot_u32(p + 44);
+    p += HEADER_SIZE;
+
+    // checksum and DF's directory follow as length-prefixed UTF8
+    if (p + strings_size > m_map + file_size) {
+        LOGE << "snapshot header is truncated";
+        return false;
+    }
+    const uchar *strings = p;
+    quint32 remaining = strings_size;
+    quint32 len = remaining < 4 ? 0 : snapshot_u32(strings);
+    if (remaining < 4 || len > remaining - 4) {
+        LOGE << "snapshot checksum runs past the string table";
+        return false;
+    }
+    m_checksum = QString::fromUtf8((const char*)strings + 4, len);
+    strings += 4 + len;
+    remaining -= 4 + len;
+    len = remaining < 4 ? 0 : snapshot_u32(strings);
+    if (remaining < 4 || len > remaining - 4) {
+        LOGE << "snapshot DF directory runs past the string table";
+        return false;
+    }
+    m_df_dir = QDir(QString::fromUtf8((const char*)strings + 4, len));
+    p += strings_size;
+
+    if (p + segment_count * SEGMENT_SIZE > m_map + file_size) {
+        LOGE << "snapshot segment table is truncated";
+        return false;
+    }
+    for (quint32 i = 0; i < segment_count; ++i) {
+        Segment seg;
+        seg.start_addr = snapshot_u32(p);
+        seg.end_addr = snapshot_u32(p + 4);
+        quint32 flags = snapshot_u32(p + 8);
+        quint64 offset = qFromLittleEndian<quint64>(p + 12);
+        p += SEGMENT_SIZE;
+        if (seg.end_addr <= seg.start_addr
+            || offset + (seg.end_addr - seg.start_addr) > (quint64)file_size) {
+            LOGW << "skipping damaged snapshot segment" << i;
+            continue;
+        }
+        seg.data = m_map + offset;
+        m_segments << seg;
+
+        MemorySegment *region = new MemorySegment(
+                flags & SEGMENT_HEAP ? "[heap]" : "",
+                seg.start_addr, seg.end_addr);
+        // version 1 snapshots only kept the heap flag, the rest stay
+        // anonymous and get scanned
+        int type = (flags >> SEGMENT_TYPE_SHIFT) & MemorySegment::SEG_ALL;
+        if (version > 1 && type)
+            region->type = type;
+        m_regions << region;
+    }
+    qSort(m_segments);
+    build_address_index();
+    LOGI << "loaded snapshot" << m_file.fileName() << "with"
+            << m_segments.size() << "segments, checksum" << m_checksum;
+    return true;
+}
+
+bool DFInstanceSnapshot::find_running_copy(bool connect_anyway) {
+    m_is_ok = load();
+    if (!m_is_ok) {
+        if (!DT->headless()) {
+            QMessageBox::warning(0, tr("Warning"),
+                tr("Unable to load the memory snapshot %1. See the log for "
+                   "details.").arg(m_file.fileName()));
+        }
+        return false;
+    }
+    m_layout = get_memory_layout(m_checksum, !connect_anyway);
+    return m_is_ok || connect_anyway;
+}
+
+quint32 DFInstanceSnapshot::calculate_checksum() {
+    return m_checksum.toUInt(0, 16);
+}
+
+void DFInstanceSnapshot::map_virtual_memory() {
+    // the segments came with the snapshot and never change
+}
+
+bool DFInstanceSnapshot::attach() {
+    m_attach_count++;
+    return true;
+}
+
+bool DFInstanceSnapshot::detach() {
+    m_attach_count--;
+    if (m_attach_count <= 0) {
+        m_attach_count = 0;
+        drop_read_cache();
+    }
+    return m_attach_count > 0;
+}
+
+const DFInstanceSnapshot::Segment *DFInstanceSnapshot::segment_for(
+        const VIRTADDR &addr) {
+    int lo = 0;
+    int hi = m_segments.size() - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const Segment &seg = m_segments.at(mid);
+        if (addr < seg.start_addr)
+            hi = mid - 1;
+        else if (addr >= seg.end_addr)
+            lo = mid + 1;
+        else
+            return &seg;
+    }
+    return 0;
+}
+
+int DFInstanceSnapshot::read_remote(const VIRTADDR &addr, int bytes,
+                                    void *buffer) {
+    char *out = static_cast<char*>(buffer);
+    memset(out, 0, bytes);
+    int bytes_read = 0;
+    quint64 ptr = addr;
+    quint64 end = (quint64)addr + bytes;
+    while (ptr < end) {
+        const Segment *seg = segment_for(ptr);
+        if (!seg) {
+            // not captured, leave it zeroed and try the next page
+            ptr = (ptr & ~0xfffULL) + 0x1000;
+            continue;
+        }
+        quint64 len = qMin<quint64>(end, seg->end_addr) - ptr;
+        memcpy(out + (ptr - addr), seg->data + (ptr - seg->start_addr), len);
+        bytes_read += len;
+        ptr += len;
+    }
+    return bytes_read;
+}
+
+//! the mapping is read-only, so workers can all copy out of it at once
+class SnapshotScanReader : public ScanReader {
+public:
+    SnapshotScanReader(DFInstanceSnapshot *snapshot)
+        : m_snapshot(snapshot)
+    {}
+    int read(const VIRTADDR &addr, int bytes, char *buffer) {
+        return m_snapshot->read_remote(addr, bytes, buffer);
+    }
+private:
+    DFInstanceSnapshot *m_snapshot;
+};
+
+ScanReader *DFInstanceSnapshot::new_scan_reader() {
+    return new SnapshotScanReader(this);
+}
+
+int DFInstanceSnapshot::read_raw(const VIRTADDR &addr, int bytes,
+                                 QByteArray &buffer) {
+    buffer.resize(bytes);
+    return read_mem(addr, bytes, buffer.data());
+}
+
+QVector<VIRTADDR> DFInstanceSnapshot::enumerate_vector(const VIRTADDR &addr) {
+    QVector<VIRTADDR> addrs;
+    if (!addr)
+        return addrs;
+
+    VIRTADDR header[2] = {0, 0}; // start and end pointers
+    read_mem(addr + VECTOR_POINTER_OFFSET, sizeof(header), header);
+    VIRTADDR start = header[0];
+    VIRTADDR end = header[1];
+    if (end <= start || (end - start) % 4 != 0)
+        return addrs;
+    int entries = (end - start) / 4;
+    if (entries > 5000) {
+        LOGW << "vector at" << hexify(addr) << "has over 5000 entries! (" <<
+                entries << ")";
+    }
+
+    addrs.resize(entries);
+    int bytes_read = read_mem(start, entries * 4, addrs.data());
+    if (bytes_read != entries * 4 && m_layout && m_layout->is_complete()) {
+        LOGW << "Tried to read" << entries * 4 << "bytes but only got"
+                << bytes_read;
+        return QVector<VIRTADDR>();
+    }
+    if (m_layout && m_layout->is_complete()) {
+        addrs = validate_pointers(addrs);
+    }
+    return addrs;
+}
+
+QString DFInstanceSnapshot::read_string(const VIRTADDR &addr) {
+#ifdef Q_WS_WIN
+    return read_msvc_string(addr);
+#else
+    return read_libstdcxx_string(addr);
+#endif
+}
+
+int DFInstanceSnapshot::write_raw(const VIRTADDR &addr, const int &bytes,
+                                  void *buffer) {
+    Q_UNUSED(buffer);
+    LOGW << "ignoring write of" << bytes << "bytes to" << hexify(addr)
+            << "(snapshots are read-only)";
+    return 0;
+}
+
+int DFInstanceSnapshot::write_string(const VIRTADDR &addr, const QString &str) {
+    Q_UNUSED(str);
+    LOGW << "ignoring string write to" << hexify(addr)
+            << "(snapshots are read-only)";
+    return 0;
+}
+
+int DFInstanceSnapshot::write_int(const VIRTADDR &addr, const int &val) {
+    return write_raw(addr, sizeof(int), (void*)&val);
+}
@@ -39,6 +39,7 @@ THE SOFTWARE.
 #include "win_structs.h"
 #include "memorysegment.h"
 #include "dwarftherapist.h"
+#include "scanengine.h"
 
 DFInstanceWindows::DFInstanceWindows(QObject* parent)
     : DFInstance(parent)
@@ -93,11 +94,11 @@ QVector<VIRTADDR> DFInstanceWindows::enumerate_vector(const VIRTADDR &addr) {
         Q_ASSERT(entries < 5000);
     }
 
-    for (VIRTADDR ptr = start; ptr < end; ptr += 4 ) {
-        VIRTADDR a = read_addr(ptr);
-        //if (is_valid_address(a)) {
-            addresses.append(a);
-        //}
+    // one read for the whole pointer block rather than one per entry
+    if (entries > 0) {
+        QByteArray data(entries * sizeof(VIRTADDR), 0);
+        read_raw(start, data.size(), data);
+        MemorySpan<VIRTADDR>(data).append_to(addresses);
     }
     TRACE << "FOUND" << addresses.size()<< "addresses in vector at"
             << hexify(addr);
@@ -105,31 +106,7 @@ QVector<VIRTADDR> DFInstanceWindows::enumerate_vector(const VIRTADDR &addr) {
 }
 
 QString DFInstanceWindows::read_string(const uint &addr) {
-    int len = read_int(addr + memory_layout()->string_length_offset());
-    int cap = read_int(addr + memory_layout()->string_cap_offset());
-    VIRTADDR buffer_addr = addr + memory_layout()->string_buffer_offset();
-    if (cap >= 16)
-        buffer_addr = read_addr(buffer_addr);
-
-    if (len > cap || len < 0 || len > 1024) {
-#ifdef _DEBUG
-        // probaby not really a string
-        LOGW << "Tried to read a string at" << hex << addr
-            << "but it was totally not a string...";
-#endif
-        return QString();
-    }
-    Q_ASSERT_X(len <= cap, "read_string",
-               "Length must be less than or equal to capacity!");
-    Q_ASSERT_X(len >= 0, "read_string", "Length must be >=0!");
-    Q_ASSERT_X(len < (1 << 16), "read_string",
-               "String must be of sane length!");
-
-    QByteArray buffer = get_data(buffer_addr, len);
-    CP437Codec *codec = new CP437Codec;
-    QString ret_val = codec->toUnicode(buffer);
-    delete codec; // seems to cause Qt Warnings if you delete this.
-    return ret_val;
+    return read_msvc_string(addr);
 }
 
 int DFInstanceWindows::write_string(const VIRTADDR &addr, const QString &str) {
@@ -150,10 +127,8 @@ int DFInstanceWindows::write_string(const VIRTADDR &addr, const QString &str) {
     int len = qMin<int>(str.length(), cap);
     write_int(addr + memory_layout()->string_length_offset(), len);
 
-    CP437Codec *codec = new CP437Codec;
-    QByteArray data = codec->fromUnicode(str);
+    QByteArray data = CP437Codec::shared()->fromUnicode(str);
     int bytes_written = write_raw(buffer_addr, len, data.data());
-    //delete codec; seems to cause Qt Warnings if you delete this.
     return bytes_written;
 }
 
@@ -164,6 +139,34 @@ int DFInstanceWindows::write_int(const VIRTADDR &addr, const int &val) {
     return bytes_written;
 }
 
+//! each scan worker reads through its own duplicate of the process handle
+class ProcessHandleScanReader : public ScanReader {
+public:
+    ProcessHandleScanReader(HANDLE proc) {
+        if (!DuplicateHandle(GetCurrentProcess(), proc, GetCurrentProcess(),
+                             &m_proc, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+            m_proc = 0;
+        }
+    }
+    ~ProcessHandleScanReader() {
+        if (m_proc)
+            CloseHandle(m_proc);
+    }
+    int read(const VIRTADDR &addr, int bytes, char *buffer) {
+        memset(buffer, 0, bytes);
+        SIZE_T bytes_read = 0;
+        if (m_proc)
+            ReadProcessMemory(m_proc, (LPCVOID)addr, buffer, bytes, &bytes_read);
+        return bytes_read;
+    }
+private:
+    HANDLE m_proc;
+};
+
+ScanReader *DFInstanceWindows::new_scan_reader() {
+    return new ProcessHandleScanReader(m_proc);
+}
+
 int DFInstanceWindows::read_raw(const VIRTADDR &addr, int bytes,
                                 QByteArray &buffer) {
     buffer.fill(0, bytes);
@@ -193,9 +196,11 @@ bool DFInstanceWindows::find_running_copy(bool connect_anyway) {
         hwnd = FindWindow(NULL, L"Dwarf Fortress");
 
     if (!hwnd) {
-        QMessageBox::warning(0, tr("Warning"),
-            tr("Unable to locate a running copy of Dwarf "
-            "Fortress, are you sure it's running?"));
+        if (!DT->headless()) {
+            QMessageBox::warning(0, tr("Warning"),
+                tr("Unable to locate a running copy of Dwarf "
+                "Fortress, are you sure it's running?"));
+        }
         LOGW << "can't find running copy";
         return m_is_ok;
     }
@@ -227,7 +232,8 @@ bool DFInstanceWindows::find_running_copy(bool connect_anyway) {
                                   "of the process. \n\nPlease re-launch DF and "
                                   "try again.");
     if (peb_addr == 0){
-        QMessageBox::critical(0, tr("Connection Error"), connection_error);
+        if (!DT->headless())
+            QMessageBox::critical(0, tr("Connection Error"), connection_error);
         qCritical() << "PEB address came back as 0";
     } else {
         PEB peb;
@@ -237,7 +243,8 @@ bool DFInstanceWindows::find_running_copy(bool connect_anyway) {
             m_base_addr = (int)peb.ImageBaseAddress;
             m_is_ok = true;
         } else {
-            QMessageBox::critical(0, tr("Connection Error"), connection_error);
+            if (!DT->headless())
+                QMessageBox::critical(0, tr("Connection Error"), connection_error);
             qCritical() << "unable to read remote PEB!" << GetLastError();
             m_is_ok = false;
         }
@@ -260,11 +267,6 @@ bool DFInstanceWindows::find_running_copy(bool connect_anyway) {
 
     map_virtual_memory();
 
-    if (DT->user_settings()->value("options/alert_on_lost_connection", true)
-        .toBool() && m_layout && m_layout->is_complete()) {
-        m_heartbeat_timer->start(1000); // check every second for disconnection
-    }
-
     char * modName = new char[MAX_PATH];
     DWORD lenModName = 0;
     if ((lenModName = GetModuleFileNameExA(m_proc, NULL, modName, MAX_PATH)) != 0) {
@@ -362,6 +364,7 @@ void DFInstanceWindows::map_virtual_memory() {
         if (seg->end_addr > m_highest_address)
             m_highest_address = seg->end_addr;
     }
+    build_address_index();
     LOGD << "MEMORY SEGMENT SUMMARY: accepted" << accepted << "rejected" <<
             rejected << "total" << accepted + rejected;
 }
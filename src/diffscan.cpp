@@ -0,0 +1,245 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <string.h>
+#include "diffscan.h"
+
+DiffScan::DiffScan(int value_size)
+    : m_value_size(value_size == 1 || value_size == 2 ? value_size : 4)
+    , m_started(false)
+    , m_candidates(0)
+{}
+
+qint32 DiffScan::value_at(const char *data, int size) {
+    switch (size) {
+    case 1:
+        return (qint8)*data;
+    case 2:
+        {
+            qint16 val;
+            memcpy(&val, data, sizeof(val));
+            return val;
+        }
+    default:
+        {
+            qint32 val;
+            memcpy(&val, data, sizeof(val));
+            return val;
+        }
+    }
+}
+
+void DiffScan::reset() {
+    m_pages.clear();
+    m_candidates = 0;
+    m_started = false;
+}
+
+QList<QPair<VIRTADDR, qint32> > DiffScan::candidates(int max,
+                                                     quint64 first) const {
+    QList<QPair<VIRTADDR, qint32> > out;
+    foreach(const Page &p, m_pages) {
+        if (first) {
+            // skip whole pages without walking their bits
+            quint64 live = p.live.count(true);
+            if (first >= live) {
+                first -= live;
+                continue;
+            }
+        }
+        for (int slot = 0; slot < p.live.size(); ++slot) {
+            if (out.size() >= max)
+                return out;
+            if (p.live.testBit(slot) && first) {
+                --first;
+            } else if (p.live.testBit(slot)) {
+                int offset = slot * m_value_size;
+                out << qMakePair(p.addr + offset, value_at(
+                        p.data.constData() + offset, m_value_size));
+            }
+        }
+    }
+    return out;
+}
+
+void DiffScan::all_candidates(QVector<VIRTADDR> &addrs,
+                              QVector<qint32> &values) const {
+    addrs.clear();
+    values.clear();
+    addrs.reserve(m_candidates);
+    values.reserve(m_candidates);
+    foreach(const Page &p, m_pages) {
+        for (int slot = 0; slot < p.live.size(); ++slot) {
+            if (p.live.testBit(slot)) {
+                int offset = slot * m_value_size;
+                addrs << p.addr + offset;
+                values << value_at(p.data.constData() + offset, m_value_size);
+            }
+        }
+    }
+}
+
+void DiffScan::restore(const QVector<VIRTADDR> &addrs,
+                       const QVector<qint32> &values) {
+    reset();
+    for (int i = 0; i < addrs.size() && i < values.size(); ++i) {
+        VIRTADDR addr = addrs.at(i);
+        int offset = addr % PAGE_SIZE;
+        if (offset % m_value_size)
+            continue; // saved with another value size
+        if (m_pages.isEmpty() || m_pages.last().addr != addr - offset) {
+            Page p;
+            p.addr = addr - offset;
+            p.data = QByteArray(PAGE_SIZE, 0);
+            p.live = QBitArray(PAGE_SIZE / m_value_size, false);
+            m_pages << p;
+        }
+        Page &p = m_pages.last();
+        qint32 val = values.at(i);
+        // DF is little endian like us, the low bytes are the value
+        memcpy(p.data.data() + offset, &val, m_value_size);
+        p.live.setBit(offset / m_value_size);
+    }
+    m_started = true;
+    finish_pass();
+}
+
+QVector<QPair<VIRTADDR, VIRTADDR> > DiffScan::page_runs() const {
+    QVector<QPair<VIRTADDR, VIRTADDR> > runs;
+    foreach(const Page &p, m_pages) {
+        if (!runs.isEmpty() && runs.last().second == p.addr) {
+            runs.last().second += PAGE_SIZE;
+        } else {
+            runs << qMakePair(p.addr, p.addr + PAGE_SIZE);
+        }
+    }
+    return runs;
+}
+
+void DiffScan::finish_pass() {
+    if (!m_started) {
+        qSort(m_pages);
+        m_started = true;
+    }
+    QVector<Page> kept;
+    kept.reserve(m_pages.size());
+    m_candidates = 0;
+    foreach(const Page &p, m_pages) {
+        int live = p.live.count(true);
+        if (live) {
+            kept << p;
+            m_candidates += live;
+        }
+    }
+    m_pages = kept;
+}
+
+DiffKernel::DiffKernel(DiffScan *scan)
+    : m_scan(scan)
+    , m_first_pass(true)
+    , m_filter(DiffScan::CHANGED)
+    , m_value(0)
+    , m_pages(0)
+    , m_page_count(0)
+{}
+
+DiffKernel::DiffKernel(DiffScan *scan, DiffScan::FILTER filter, qint32 value)
+    : m_scan(scan)
+    , m_first_pass(false)
+    , m_filter(filter)
+    , m_value(value)
+    , m_pages(scan->m_pages.data()) // detach now, not from the workers
+    , m_page_count(scan->m_pages.size())
+{
+    // compare against what a value of this size can actually hold
+    char buf[sizeof(qint32)];
+    memcpy(buf, &value, sizeof(buf));
+    m_value = DiffScan::value_at(buf, scan->m_value_size);
+}
+
+DiffScan::Page *DiffKernel::find_page(const VIRTADDR &addr) const {
+    int lo = 0;
+    int hi = m_page_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_pages[mid].addr < addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < m_page_count && m_pages[lo].addr == addr ? m_pages + lo : 0;
+}
+
+bool DiffKernel::passes(qint32 old_val, qint32 new_val) const {
+    switch (m_filter) {
+    case DiffScan::CHANGED:
+        return new_val != old_val;
+    case DiffScan::UNCHANGED:
+        return new_val == old_val;
+    case DiffScan::INCREASED:
+        return new_val > old_val;
+    case DiffScan::DECREASED:
+        return new_val < old_val;
+    case DiffScan::EQUALS:
+    default:
+        return new_val == m_value;
+    }
+}
+
+void DiffKernel::scan(const VIRTADDR &addr, const char *data,
+                      int chunk_bytes, int, QVector<VIRTADDR> &) const {
+    const int page_size = DiffScan::PAGE_SIZE;
+    int size = m_scan->m_value_size;
+    int first = (page_size - addr % page_size) % page_size;
+
+    if (m_first_pass) {
+        QVector<DiffScan::Page> pages;
+        for (int off = first; off + page_size <= chunk_bytes; off += page_size) {
+            DiffScan::Page p;
+            p.addr = addr + off;
+            p.data = QByteArray(data + off, page_size);
+            p.live = QBitArray(page_size / size, true);
+            pages << p;
+        }
+        QMutexLocker locker(&m_scan->m_lock);
+        m_scan->m_pages << pages;
+        return;
+    }
+
+    for (int off = first; off + page_size <= chunk_bytes; off += page_size) {
+        DiffScan::Page *p = find_page(addr + off);
+        if (!p)
+            continue;
+        const char *now = data + off;
+        const char *before = p->data.constData();
+        for (int slot = 0; slot < p->live.size(); ++slot) {
+            if (!p->live.testBit(slot))
+                continue;
+            int pos = slot * size;
+            if (!passes(DiffScan::value_at(before + pos, size),
+                        DiffScan::value_at(now + pos, size))) {
+                p->live.clearBit(slot);
+            }
+        }
+        memcpy(p->data.data(), now, page_size);
+    }
+}
@@ -64,9 +64,12 @@ Dwarf::Dwarf(DFInstance *df, const uint &addr, QObject *parent)
     read_settings();
     refresh_data();
     connect(DT, SIGNAL(settings_changed()), SLOT(read_settings()));
+}
 
-    // setup context actions
-    m_actions.clear();
+QList<QAction*> Dwarf::get_actions() {
+    // made on first use, most dwarves never get a context menu
+    if (!m_actions.isEmpty())
+        return m_actions;
     QAction *show_details = new QAction(tr("Show Details..."), this);
     connect(show_details, SIGNAL(triggered()), SLOT(show_details()));
     m_actions << show_details;
@@ -85,6 +88,7 @@ Dwarf::Dwarf(DFInstance *df, const uint &addr, QObject *parent)
     QAction *dump_soul = new QAction(tr("Dump Souls..."), this);
     connect(dump_soul, SIGNAL(triggered()), SLOT(dump_souls()));
     m_actions << dump_soul;
+    return m_actions;
 }
 
 
@@ -122,21 +126,20 @@ void Dwarf::refresh_data() {
     m_mem = m_df->memory_layout();
     TRACE << "Starting refresh of dwarf data at" << hexify(m_address);
 
-    // read everything we need
-    read_id();
-    read_caste();
-    read_race();
+    m_footprint.clear();
+    // pull all the fixed size fields in one go, then read everything else
+    QByteArray labors(102, 0);
+    VIRTADDR current_job_addr = 0;
+    read_fields(labors, current_job_addr);
     read_first_name();
     read_last_name();
     read_nick_name();
     calc_names();
     read_profession();
-    read_labors();
+    read_labors(labors);
     read_happiness();
-    read_current_job();
+    read_current_job(current_job_addr);
     read_souls();
-    read_squad_ref_id();
-    read_turn_count();
 
     /* OLD Stuff from the 40d series that no longer works the same way
     m_strength = m_df->read_int(m_address + mem->dwarf_offset("strength"));
@@ -183,28 +186,77 @@ void Dwarf::refresh_data() {
   DATA POPULATION METHODS
 *******************************************************************************/
 
-void Dwarf::read_id() {
-    m_id = m_df->read_int(m_address + m_mem->dwarf_offset("id"));
+//! remember the pages [addr, addr + bytes) covers for is_unchanged()
+void Dwarf::add_to_footprint(const VIRTADDR &addr, int bytes) {
+    for (VIRTADDR page = addr & ~0xfff; page < addr + bytes; page += 0x1000) {
+        if (!m_footprint.contains(page))
+            m_footprint << page;
+    }
+}
+
+//! read_string() for a string of ours, adding it to the footprint
+QString Dwarf::read_footprint_string(const VIRTADDR &addr) {
+    QVector<ReadRequest> extents;
+    QString str = m_df->read_tracked_string(addr, extents);
+    foreach(const ReadRequest &r, extents) {
+        add_to_footprint(r.addr, r.bytes);
+    }
+    return str;
+}
+
+bool Dwarf::is_unchanged() {
+    // pending changes would be lost, or were just written, so re-read those
+    return !m_footprint.isEmpty() && !pending_changes()
+            && !m_df->pages_changed(m_footprint);
+}
+
+/*! Most of what we want from a creature is a handful of small fields
+    scattered over its struct, so fetch them with one batched read
+    rather than a read per field. The labor block and current job pointer
+    come back to the caller for read_labors() and read_current_job().
+*/
+void Dwarf::read_fields(QByteArray &labors, VIRTADDR &current_job_addr) {
+    BYTE sex = 0;
+    BYTE profession = 0;
+    QVector<ReadRequest> batch;
+    batch << ReadRequest(m_address + m_mem->dwarf_offset("id"), sizeof(m_id), &m_id)
+          << ReadRequest(m_address + m_mem->dwarf_offset("sex"), sizeof(sex), &sex)
+          << ReadRequest(m_address + m_mem->dwarf_offset("race"), sizeof(m_race_id), &m_race_id)
+          << ReadRequest(m_address + m_mem->dwarf_offset("profession"), sizeof(profession), &profession)
+          << ReadRequest(m_address + m_mem->dwarf_offset("labors"), labors.size(), labors.data())
+          << ReadRequest(m_address + m_mem->dwarf_offset("happiness"), sizeof(m_raw_happiness), &m_raw_happiness)
+          << ReadRequest(m_address + m_mem->dwarf_offset("current_job"), sizeof(current_job_addr), &current_job_addr)
+          << ReadRequest(m_address + m_mem->dwarf_offset("squad_ref_id"), sizeof(m_squad_ref_id), &m_squad_ref_id)
+          << ReadRequest(m_address + m_mem->dwarf_offset("turn_count"), sizeof(m_turn_count), &m_turn_count);
+    m_df->read_stable(batch);
+    foreach(const ReadRequest &r, batch) {
+        add_to_footprint(r.addr, r.bytes);
+    }
+    // name and soul pointers live in the struct too
+    const char *pointer_fields[] = {"first_name", "nick_name", "last_name",
+                                    "custom_profession", "souls"};
+    for (uint i = 0; i < sizeof(pointer_fields) / sizeof(*pointer_fields); ++i) {
+        add_to_footprint(m_address + m_mem->dwarf_offset(pointer_fields[i]),
+                         3 * sizeof(VIRTADDR));
+    }
+    // the last name is word ids, read_chunked_name() goes up to 0x1c
+    add_to_footprint(m_address + m_mem->dwarf_offset("last_name"), 0x1c);
+
     //m_id = m_address; // HACK: this will allow dwarfs in the list even when
     // the id offset isn't know for this version
     TRACE << "ID:" << m_id;
-}
-
-void Dwarf::read_caste() {
     // TODO: actually break down this caste
-    BYTE sex = m_df->read_byte(m_address + m_mem->dwarf_offset("sex"));
     m_is_male = (int)sex == 1;
     TRACE << "MALE:" << m_is_male;
-}
-
-void Dwarf::read_race() {
-    m_race_id = m_df->read_int(m_address + m_mem->dwarf_offset("race"));
     TRACE << "RACE ID:" << m_race_id;
+    m_raw_profession = profession;
+    TRACE << "Squad Reference ID:" << m_squad_ref_id;
+    TRACE << "Turn Count:" << m_turn_count;
 }
 
 void Dwarf::read_first_name() {
-    m_first_name = m_df->read_string(m_address +
-                                     m_mem->dwarf_offset("first_name"));
+    m_first_name = read_footprint_string(m_address +
+                                         m_mem->dwarf_offset("first_name"));
     if (m_first_name.size() > 1)
         m_first_name[0] = m_first_name[0].toUpper();
     TRACE << "FIRSTNAME:" << m_first_name;
@@ -266,8 +318,8 @@ void Dwarf::read_last_name() {
 
 
 void Dwarf::read_nick_name() {
-    m_nick_name = m_df->read_string(m_address +
-                                    m_mem->dwarf_offset("nick_name"));
+    m_nick_name = read_footprint_string(m_address +
+                                        m_mem->dwarf_offset("nick_name"));
     TRACE << "\tNICKNAME:" << m_nick_name;
     m_pending_nick_name = m_nick_name;
 }
@@ -310,15 +362,13 @@ void Dwarf::calc_names() {
 void Dwarf::read_profession() {
     // first see if there is a custom prof set...
     VIRTADDR custom_addr = m_address + m_mem->dwarf_offset("custom_profession");
-    m_custom_profession = m_df->read_string(custom_addr);
+    m_custom_profession = read_footprint_string(custom_addr);
     TRACE << "\tCUSTOM PROF:" << m_custom_profession;
 
     // we set both to the same to know it hasn't been edited yet
     m_pending_custom_profession = m_custom_profession;
 
-    // now read the actual profession by id
-    VIRTADDR addr = m_address + m_mem->dwarf_offset("profession");
-    m_raw_profession = m_df->read_byte(addr);
+    // the actual profession id came in with read_fields()
     Profession *p = GameDataReader::ptr()->get_profession(m_raw_profession);
     QString prof_name = tr("Unknown Profession %1").arg(m_raw_profession);
     if (p) {
@@ -339,13 +389,9 @@ void Dwarf::read_profession() {
     TRACE << "EFFECTIVE PROFESSION:" << m_profession;
 }
 
-void Dwarf::read_labors() {
-    VIRTADDR addr = m_address + m_mem->dwarf_offset("labors");
-    // read a big array of labors in one read, then pick and choose
-    // the values we care about
-    QByteArray buf(102, 0);
-    m_df->read_raw(addr, 102, buf);
-
+void Dwarf::read_labors(const QByteArray &buf) {
+    // the big array of labors was read in one go by read_fields(), now pick
+    // and choose the values we care about
     // get the list of identified labors from game_data.ini
     GameDataReader *gdr = GameDataReader::ptr();
     foreach(Labor *l, gdr->get_ordered_labors()) {
@@ -361,33 +407,31 @@ void Dwarf::read_labors() {
 }
 
 void Dwarf::read_happiness() {
-    VIRTADDR addr = m_address + m_mem->dwarf_offset("happiness");
-    m_raw_happiness = m_df->read_int(addr);
     m_happiness = happiness_from_score(m_raw_happiness);
     TRACE << "\tRAW HAPPINESS:" << m_raw_happiness;
     TRACE << "\tHAPPINESS:" << happiness_name(m_happiness);
 }
 
-void Dwarf::read_current_job() {
+void Dwarf::read_current_job(const VIRTADDR &current_job_addr) {
     // TODO: jobs contain info about materials being used, if we ever get the
     // material list we could show that in here
-    VIRTADDR addr = m_address + m_mem->dwarf_offset("current_job");
-    VIRTADDR current_job_addr = m_df->read_addr(addr);
-
     m_current_sub_job_id.clear();
 
     TRACE << "Current job addr: " << hex << current_job_addr;
 
     if (current_job_addr != 0) {
-        m_current_job_id = m_df->read_word(current_job_addr +
-                                     m_df->memory_layout()->job_detail("id"));
+        VIRTADDR job_id_addr = current_job_addr +
+                               m_df->memory_layout()->job_detail("id");
+        m_current_job_id = m_df->read_word(job_id_addr);
+        add_to_footprint(job_id_addr, sizeof(WORD));
         DwarfJob *job = GameDataReader::ptr()->get_job(m_current_job_id);
         if (job) {
             m_current_job = job->description;
 
             int sub_job_offset = m_df->memory_layout()->job_detail("sub_job_id");
             if(sub_job_offset != -1) {
-                m_current_sub_job_id = m_df->read_string(current_job_addr + sub_job_offset);
+                m_current_sub_job_id = read_footprint_string(current_job_addr +
+                                                             sub_job_offset);
                 if(!job->reactionClass.isEmpty() && !m_current_sub_job_id.isEmpty()) {
                     RawObjectPtr reaction = GameDataReader::ptr()->
                             get_reaction(job->reactionClass, m_current_sub_job_id);
@@ -407,8 +451,10 @@ void Dwarf::read_current_job() {
         if (states_offset) {
             VIRTADDR states_addr = m_address + states_offset;
             QVector<uint> entries = m_df->enumerate_vector(states_addr);
+            add_to_footprint(states_addr, 3 * sizeof(VIRTADDR));
             short on_break_value = layout->job_detail("on_break_flag");
             foreach(uint entry, entries) {
+                add_to_footprint(entry, sizeof(short));
                 if (m_df->read_short(entry) == on_break_value) {
                     is_on_break = true;
                     break; // no pun intended
@@ -487,9 +533,14 @@ Dwarf *Dwarf::get_dwarf(DFInstance *df, const VIRTADDR &addr) {
     TRACE << "attempting to load dwarf at" << addr << "using memory layout"
             << mem->game_version();
 
-    quint32 flags1 = df->read_addr(addr + mem->dwarf_offset("flags1"));
-    quint32 flags2 = df->read_addr(addr + mem->dwarf_offset("flags2"));
-    WORD race_id = df->read_word(addr + mem->dwarf_offset("race"));
+    quint32 flags1 = 0;
+    quint32 flags2 = 0;
+    WORD race_id = 0;
+    QVector<ReadRequest> batch;
+    batch << ReadRequest(addr + mem->dwarf_offset("flags1"), sizeof(flags1), &flags1)
+          << ReadRequest(addr + mem->dwarf_offset("flags2"), sizeof(flags2), &flags2)
+          << ReadRequest(addr + mem->dwarf_offset("race"), sizeof(race_id), &race_id);
+    df->read_stable(batch);
 
     if (race_id != df->dwarf_race_id()) { // we only care about dwarfs
         TRACE << "Ignoring creature with race ID of " << hex << race_id;
@@ -572,8 +623,11 @@ Dwarf *Dwarf::get_dwarf(DFInstance *df, const VIRTADDR &addr) {
 void Dwarf::read_traits() {
     VIRTADDR addr = m_first_soul + m_mem->soul_detail("traits");
     m_traits.clear();
+    qint16 vals[30];
+    m_df->read_mem(addr, sizeof(vals), vals);
+    add_to_footprint(addr, sizeof(vals));
     for (int i = 0; i < 30; ++i) {
-        short val = m_df->read_short(addr + i * 2);
+        short val = vals[i];
         int deviation = abs(val - 50); // how far from the norm is this trait?
         if (deviation <= 10) {
             val = -1; // this will cause median scores to not be treated as "active" traits
@@ -582,46 +636,48 @@ void Dwarf::read_traits() {
     }
 }
 
-void Dwarf::read_squad_ref_id() {
-    m_squad_ref_id = m_df->read_int(m_address + m_mem->dwarf_offset("squad_ref_id"));
-    TRACE << "Squad Reference ID:" << m_squad_ref_id;
-}
-
-void Dwarf::read_turn_count() {
-    m_turn_count = m_df->read_int(m_address + m_mem->dwarf_offset("turn_count"));
-    TRACE << "Turn Count:" << m_turn_count;
-}
+/* type, level, experience, last used counter, rust, rust counter,
+demotion counter
+*/
+struct SkillData {
+    qint16 type;
+    qint16 unk_02;
+    qint16 rating;
+    qint16 unk_06;
+    qint32 xp;
+    qint32 last_used;
+    qint32 rust;
+    qint32 rust_counter;
+    qint32 demotion_counter;
+};
 
 void Dwarf::read_skills() {
     VIRTADDR addr = m_first_soul + m_mem->soul_detail("skills");
     m_total_xp = 0;
     m_skills.clear();
     QVector<VIRTADDR> entries = m_df->enumerate_vector(addr);
+    // skills coming or going moves the vector's end pointer in the soul
+    add_to_footprint(addr, 3 * sizeof(VIRTADDR));
     TRACE << "Reading skills for" << nice_name() << "found:" << entries.size();
-    short type = 0;
-    short rating = 0;
-    int xp = 0;
-    int last_used = 0;
-    int rust = 0;
-    int rust_counter = 0;
-    int demotion_counter = 0;
-    foreach(VIRTADDR entry, entries) {
-        /* type, level, experience, last used counter, rust, rust counter,
-        demotion counter
-        */
-        type = m_df->read_short(entry);
-        rating = m_df->read_short(entry + 0x04);
-        xp = m_df->read_int(entry + 0x08);
-        last_used =m_df->read_int(entry + 0x0C);
-        rust = m_df->read_int(entry + 0x10);
-        rust_counter = m_df->read_int(entry + 0x14);
-        demotion_counter = m_df->read_int(entry + 0x18);
-
-        TRACE   << "reading skill at" << hex << entry << "type" << dec << type
-                << "rating" << rating << "xp:" << xp << "last_used:"
-                << last_used << "rust:" << rust << "rust counter:"
-                << rust_counter << "demotions:" << demotion_counter;
-        Skill s(type, xp, rating);
+
+    QVector<SkillData> data(entries.size());
+    QVector<ReadRequest> batch;
+    batch.reserve(entries.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        batch << ReadRequest(entries.at(i), sizeof(SkillData), &data[i]);
+        add_to_footprint(entries.at(i), sizeof(SkillData));
+    }
+    m_df->read_stable(batch);
+
+    m_skills.reserve(entries.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        const SkillData &sd = data.at(i);
+        TRACE   << "reading skill at" << hex << entries.at(i) << "type" << dec
+                << sd.type << "rating" << sd.rating << "xp:" << sd.xp
+                << "last_used:" << sd.last_used << "rust:" << sd.rust
+                << "rust counter:" << sd.rust_counter << "demotions:"
+                << sd.demotion_counter;
+        Skill s(sd.type, sd.xp, sd.rating);
         m_total_xp += s.actual_exp();
         m_skills.append(s);
     }
@@ -734,29 +790,28 @@ void Dwarf::commit_pending() {
     MemoryLayout *mem = m_df->memory_layout();
     int addr = m_address + mem->dwarf_offset("labors");
 
-    QByteArray buf(102, 0);
-    m_df->read_raw(addr, 102, buf); // set the buffer as it is in-game
-    foreach(int labor_id, m_pending_labors.uniqueKeys()) {
+    // only the labors that changed go into DF's write plan, one byte each;
+    // DwarfModel::commit_pending() applies every dwarf's plan in one go
+    QVector<int> labors = get_dirty_labors();
+    foreach(int labor_id, labors) {
         if (labor_id < 0)
             continue;
-        // change values to what's pending
-        buf[labor_id] = m_pending_labors.value(labor_id);
+        m_df->queue_write(addr + labor_id,
+                          QByteArray(1, (char)m_pending_labors.value(labor_id)));
     }
 
-    m_df->write_raw(addr, 102, buf.data());
-
-    // We'll set the "recheck_equipment" flag because there was a labor change.
-    BYTE recheck_equipment = m_df->read_byte(m_address +
-                                     mem->dwarf_offset("recheck_equipment"));
-    recheck_equipment |= 1;
-    m_df->write_raw(m_address + mem->dwarf_offset("recheck_equipment"), 1,
-                    &recheck_equipment);
+    if (!labors.isEmpty()) {
+        // We'll set the "recheck_equipment" flag because there was a labor change.
+        VIRTADDR recheck_addr = m_address + mem->dwarf_offset("recheck_equipment");
+        BYTE recheck_equipment = m_df->read_byte(recheck_addr);
+        recheck_equipment |= 1;
+        m_df->queue_write(recheck_addr, QByteArray(1, (char)recheck_equipment));
+    }
 
     if (m_pending_nick_name != m_nick_name)
         m_df->write_string(m_address + mem->dwarf_offset("nick_name"), m_pending_nick_name);
     if (m_pending_custom_profession != m_custom_profession)
         m_df->write_string(m_address + mem->dwarf_offset("custom_profession"), m_pending_custom_profession);
-    refresh_data();
 }
 
 void Dwarf::set_nickname(const QString &nick) {
@@ -36,20 +36,27 @@ THE SOFTWARE.
 #include "memorylayout.h"
 #include "truncatingfilelogger.h"
 
-DwarfTherapist::DwarfTherapist(int &argc, char **argv)
-    : QApplication(argc, argv)
+DwarfTherapist::DwarfTherapist(int &argc, char **argv, bool headless)
+    : QApplication(argc, argv, !headless)
     , m_user_settings(0)
     , m_main_window(0)
     , m_options_menu(0)
     , m_reading_settings(false)
     , m_allow_labor_cheats(false)
     , m_log_mgr(0)
+    , m_headless(headless)
 {
     setup_logging();
     load_translator();
 
     TRACE << "Creating settings object";
     m_user_settings = new QSettings(QSettings::IniFormat, QSettings::UserScope, COMPANY, PRODUCT, this);
+    if (m_headless) {
+        // no widgets without a display, the caller drives everything
+        m_allow_labor_cheats = m_user_settings->value(
+                "options/allow_labor_cheats", false).toBool();
+        return;
+    }
     TRACE << "Creating options menu";
     m_options_menu = new OptionsMenu;
     TRACE << "Creating main window";
@@ -327,7 +334,7 @@ void DwarfTherapist::load_game_translation_tables(DFInstance *df) {
     TRACE << "GENERIC LANGUAGE VECTOR" << hex << generic_lang_table;
     TRACE << "WORD TABLE OFFSET" << hex << word_table_offset;
 
-    df->attach();
+    DFReadSession session(df);
     if (generic_lang_table != 0xFFFFFFFF && generic_lang_table != 0) {
         LOGD << "Loading generic strings from" << hex << generic_lang_table;
         QVector<uint> generic_words = df->enumerate_vector(generic_lang_table);
@@ -356,5 +363,4 @@ void DwarfTherapist::load_game_translation_tables(DFInstance *df) {
             m_dwarf_words << df->read_string(word_ptr);
         }
     }
-    df->detach();
 }
@@ -36,7 +36,8 @@ LayoutCreator::LayoutCreator(DFInstance * df, MemoryLayout * parent, QString fil
         m_language_vector(0),
         m_creature_vector(0),
         m_squad_vector(0),
-        m_current_year(0)
+        m_current_year(0),
+        m_word_table_offset(0)
 {
 
 }
@@ -73,6 +74,9 @@ bool LayoutCreator::write_file()
     newLayout.set_address("addresses/dwarf_race_index", m_dwarf_race_index);
     newLayout.set_address("addresses/squad_vector", m_squad_vector);
     newLayout.set_address("addresses/current_year", m_current_year);
+    if(m_word_table_offset) {
+        newLayout.set_address("offsets/word_table", m_word_table_offset);
+    }
     newLayout.set_complete();
     LOGD << "\tWriting file.";
     newLayout.save_data();
@@ -109,3 +113,11 @@ void LayoutCreator::report_address(const QString& name, const quint32& addr)
         m_current_year = corrected_addr;
     }
 }
+
+void LayoutCreator::report_offset(const QString& name, const int& offset)
+{
+    if(name == "word_table" && m_word_table_offset == 0)
+    {
+        m_word_table_offset = offset;
+    }
+}
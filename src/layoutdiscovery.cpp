@@ -0,0 +1,131 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "layoutdiscovery.h"
+#include "scannerthread.h"
+#include "scannerconnection.h"
+#include "truncatingfilelogger.h"
+
+LayoutDiscovery::LayoutDiscovery(QObject *thread_parent, QObject *parent)
+    : QObject(parent)
+    , m_thread_parent(thread_parent)
+    , m_running(0)
+    , m_done(0)
+    , m_cancelled(false)
+{}
+
+void LayoutDiscovery::add_step(SCANNER_JOB_TYPE job,
+                               const QList<SCANNER_JOB_TYPE> &after,
+                               const QString &input) {
+    Step s;
+    s.job = job;
+    s.after = after;
+    s.input = input;
+    s.thread = 0;
+    s.done = false;
+    m_steps << s;
+}
+
+void LayoutDiscovery::run() {
+    m_running = 0;
+    m_done = 0;
+    m_cancelled = false;
+    emit total_steps(m_steps.size());
+    emit steps_done(0);
+    start_ready_steps();
+    if (m_running)
+        m_loop.exec();
+}
+
+void LayoutDiscovery::cancel() {
+    m_cancelled = true;
+    ScannerConnection::cancel_scan();
+}
+
+bool LayoutDiscovery::is_done(SCANNER_JOB_TYPE job) const {
+    foreach(const Step &s, m_steps) {
+        if (s.job == job && !s.done)
+            return false;
+    }
+    return true;
+}
+
+void LayoutDiscovery::start_ready_steps() {
+    int max_running = ScannerConnection::allows_concurrent_jobs()
+                      ? MAX_CONCURRENT_STEPS : 1;
+    for (int i = 0; i < m_steps.size(); ++i) {
+        if (m_cancelled || m_running >= max_running)
+            break;
+        Step &s = m_steps[i];
+        if (s.thread || s.done)
+            continue;
+        bool ready = true;
+        foreach(SCANNER_JOB_TYPE job, s.after) {
+            ready = ready && is_done(job);
+        }
+        if (!ready)
+            continue;
+
+        s.thread = new ScannerThread(m_thread_parent);
+        s.thread->set_job(s.job);
+        if (!s.input.isEmpty() && m_found.contains(s.input))
+            s.thread->set_meta(encode(m_found.value(s.input)));
+        connect(s.thread, SIGNAL(scan_message(const QString&)),
+                SIGNAL(scan_message(const QString&)));
+        connect(s.thread, SIGNAL(found_address(const QString&, const quint32&)),
+                SLOT(record_address(const QString&, const quint32&)));
+        connect(s.thread, SIGNAL(found_offset(const QString&, const int&)),
+                SIGNAL(found_offset(const QString&, const int&)));
+        // reports are queued from the job's thread before this is, so
+        // everything a step found is in by the time it counts as done
+        connect(s.thread, SIGNAL(finished()), SLOT(step_finished()));
+        ScannerConnection::lend_to(s.thread);
+        LOGD << "starting discovery step" << s.job;
+        ++m_running;
+        s.thread->start();
+    }
+    if (!m_running)
+        m_loop.quit();
+}
+
+void LayoutDiscovery::record_address(const QString &name,
+                                     const quint32 &addr) {
+    if (!m_found.contains(name))
+        m_found.insert(name, addr);
+    emit found_address(name, addr);
+}
+
+void LayoutDiscovery::step_finished() {
+    ScannerThread *thread = qobject_cast<ScannerThread*>(sender());
+    for (int i = 0; i < m_steps.size(); ++i) {
+        Step &s = m_steps[i];
+        if (s.thread != thread)
+            continue;
+        s.thread = 0;
+        s.done = true;
+        --m_running;
+        emit steps_done(++m_done);
+        LOGD << "discovery step" << s.job << "finished";
+    }
+    thread->deleteLater();
+    start_ready_steps();
+}
@@ -48,6 +48,7 @@ THE SOFTWARE.
 #include "columntypes.h"
 #include "rotatedheader.h"
 #include "scanner.h"
+#include "dfinstancesnapshot.h"
 #include "scriptdialog.h"
 #include "truncatingfilelogger.h"
 
@@ -214,13 +215,49 @@ void MainWindow::closeEvent(QCloseEvent *evt) {
 
 void MainWindow::connect_to_df() {
     LOGD << "attempting connection to running DF game";
+    connect_to(DFInstance::newInstance());
+}
+
+void MainWindow::open_snapshot() {
+    QString path = QFileDialog::getOpenFileName(this,
+        tr("Choose a memory snapshot to open"), QString(),
+        "Dwarf Therapist Memory Snapshots (*.dtm);;All Files (*.*)");
+    if (path.isEmpty())
+        return; // they cancelled
+    LOGD << "opening memory snapshot" << path;
+    connect_to(new DFInstanceSnapshot(path));
+}
+
+void MainWindow::capture_snapshot() {
+    if (!m_df || !m_df->is_ok())
+        return;
+    QString default_path = QString("%1/%2")
+        .arg(QDesktopServices::storageLocation(QDesktopServices::DesktopLocation))
+        .arg("fort.dtm");
+    QString path = QFileDialog::getSaveFileName(this,
+        tr("Choose where to save the memory snapshot"), default_path,
+        "Dwarf Therapist Memory Snapshots (*.dtm);;All Files (*.*)");
+    if (path.isEmpty())
+        return; // they cancelled
+    LOGD << "capturing memory snapshot to" << path;
+    if (!m_df->save_snapshot(path)) {
+        QMessageBox::warning(this, tr("Snapshot Failed"),
+            tr("Unable to write a memory snapshot to %1. See the log for "
+               "details.").arg(path));
+    }
+}
+
+void MainWindow::connect_to(DFInstance *df) {
     if (m_df) {
         LOGD << "already connected, disconnecting";
+        // the scanner holds on to m_df
+        delete m_scanner;
+        m_scanner = 0;
         delete m_df;
         set_interface_enabled(false);
         m_df = 0;
     }
-    m_df = DFInstance::newInstance();
+    m_df = df;
 
     // find_running_copy can fail for several reasons, and will take care of
     // logging and notifying the user.
@@ -256,8 +293,11 @@ void MainWindow::connect_to_df() {
             // if the memory layout is still being mapped don't read all this
             // in yet
             DT->load_game_translation_tables(m_df);
-            connect(m_df, SIGNAL(connection_interrupted()),
-                    SLOT(lost_df_connection()));
+            connect(m_df, SIGNAL(process_gone()), SLOT(lost_df_connection()));
+            connect(m_df, SIGNAL(fort_unloaded()), SLOT(lost_df_connection()));
+            connect(m_df, SIGNAL(creatures_changed()),
+                    SLOT(df_creatures_changed()));
+            m_df->start_heartbeat();
 
             //Read raws once memory layout is complete
             m_df->read_raws();
@@ -286,6 +326,18 @@ void MainWindow::lost_df_connection() {
     }
 }
 
+void MainWindow::df_creatures_changed() {
+    if (m_model->get_dwarves().isEmpty())
+        return; // nothing read yet, so nothing to refresh
+    // re-reading would throw away whatever the user hasn't committed yet
+    if (!m_model->get_dirty_dwarves().isEmpty()) {
+        LOGI << "creatures changed in DF, not re-reading over pending changes";
+        return;
+    }
+    LOGI << "creatures changed in DF, re-reading";
+    read_dwarves();
+}
+
 void MainWindow::read_dwarves() {
     if (!m_df || !m_df->is_ok()) {
         lost_df_connection();
@@ -326,6 +378,7 @@ void MainWindow::set_interface_enabled(bool enabled) {
     ui->cb_group_by->setEnabled(enabled);
     ui->act_import_existing_professions->setEnabled(enabled);
     ui->act_print->setEnabled(enabled);
+    ui->act_capture_snapshot->setEnabled(enabled);
 }
 
 void MainWindow::check_latest_version(bool show_result_on_equal) {
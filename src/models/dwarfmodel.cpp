@@ -74,27 +74,32 @@ void DwarfModel::section_right_clicked(int col) {
 }
 
 void DwarfModel::load_dwarves() {
-    // clear id->dwarf map
+    // clear id->dwarf map, keeping the dwarves around in case DF hasn't
+    // touched them since the last read
+    QHash<VIRTADDR, Dwarf*> previous;
     foreach(Dwarf *d, m_dwarves) {
-        delete d;
+        previous.insert(d->address(), d);
     }
     m_dwarves.clear();
     if (rowCount())
         removeRows(0, rowCount());
 
-    m_df->attach();
-
-    foreach(Dwarf *d, m_df->load_dwarves()) {
-        m_dwarves[d->id()] = d;
-    }
+    {
+        // creatures and squads are read while DF is stopped just once
+        DFReadSession session(m_df);
+        foreach(Dwarf *d, m_df->load_dwarves(&previous)) {
+            m_dwarves[d->id()] = d;
+        }
+        foreach(Dwarf *d, previous) {
+            delete d;
+        }
 
-    m_squads.clear();
-    foreach(Squad * s, m_df->load_squads()) {
-        m_squads[s->id()] = s;
+        m_squads.clear();
+        foreach(Squad * s, m_df->load_squads()) {
+            m_squads[s->id()] = s;
+        }
     }
 
-    m_df->detach();
-
     QList<Dwarf *> dwarves = m_dwarves.values();
     qSort(dwarves.begin(), dwarves.end(), compare_turn_count);
 
@@ -479,9 +484,19 @@ void DwarfModel::clear_pending() {
 }
 
 void DwarfModel::commit_pending() {
-    foreach(Dwarf *d, m_dwarves) {
-        if (d->pending_changes()) {
-            d->commit_pending();
+    {
+        DFReadSession session(m_df);
+        foreach(Dwarf *d, m_dwarves) {
+            if (d->pending_changes()) {
+                d->commit_pending();
+            }
+        }
+        if (!m_df->commit_writes()) {
+            // everything was rolled back, so keep the pending changes around
+            // for the user to look at or try again
+            m_df->discard_writes();
+            LOGE << "unable to commit pending labor changes";
+            return;
         }
     }
     load_dwarves();
@@ -101,6 +101,9 @@ OptionsMenu::OptionsMenu(QWidget *parent)
     connect(ui->btn_restore_defaults, SIGNAL(pressed()), this, SLOT(restore_defaults()));
     connect(ui->btn_change_font, SIGNAL(pressed()), this, SLOT(show_font_chooser()));
     connect(ui->cb_auto_contrast, SIGNAL(toggled(bool)), m_general_colors[0], SLOT(setDisabled(bool)));
+#ifndef Q_WS_X11
+    ui->cb_live_reads->hide(); // only the linux reader can work unstopped
+#endif
     read_settings();
 }
 
@@ -157,6 +160,7 @@ void OptionsMenu::read_settings() {
     ui->cb_show_dabbling_in_tooltip->setChecked(s->value("show_dabbling_in_tooltips", true).toBool());
     ui->cb_check_for_updates_on_startup->setChecked(s->value("check_for_updates_on_startup", true).toBool());
     ui->cb_alert_on_lost_connection->setChecked(s->value("alert_on_lost_connection", true).toBool());
+    ui->cb_live_reads->setChecked(s->value("live_reads", false).toBool());
     ui->cb_labor_cheats->setChecked(s->value("allow_labor_cheats", false).toBool());
     ui->cb_hide_children->setChecked(s->value("hide_children_and_babies", false).toBool());
     ui->cb_generic_names->setChecked(s->value("use_generic_names", false).toBool());
@@ -197,6 +201,7 @@ void OptionsMenu::write_settings() {
         s->setValue("show_dabbling_in_tooltips", ui->cb_show_dabbling_in_tooltip->isChecked());
         s->setValue("check_for_updates_on_startup", ui->cb_check_for_updates_on_startup->isChecked());
         s->setValue("alert_on_lost_connection", ui->cb_alert_on_lost_connection->isChecked());
+        s->setValue("live_reads", ui->cb_live_reads->isChecked());
         s->setValue("allow_labor_cheats", ui->cb_labor_cheats->isChecked());
         s->setValue("hide_children_and_babies", ui->cb_hide_children->isChecked());
         s->setValue("use_generic_names", ui->cb_generic_names->isChecked());
@@ -235,6 +240,7 @@ void OptionsMenu::restore_defaults() {
     ui->cb_show_dabbling_in_tooltip->setChecked(true);
     ui->cb_check_for_updates_on_startup->setChecked(true);
     ui->cb_alert_on_lost_connection->setChecked(true);
+    ui->cb_live_reads->setChecked(false);
     ui->cb_labor_cheats->setChecked(false);
 
     m_font = QFont("Segoe UI", 8);
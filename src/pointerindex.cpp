@@ -0,0 +1,48 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "pointerindex.h"
+
+PointerIndex::PointerIndex(const QVector<VIRTADDR> &records) {
+    // pack each pair into one key so a plain sort orders by value, then
+    // by address
+    QVector<quint64> keys(records.size() / 2);
+    for (int i = 0; i < keys.size(); ++i) {
+        keys[i] = ((quint64)records.at(i * 2) << 32) | records.at(i * 2 + 1);
+    }
+    qSort(keys);
+
+    m_values.resize(keys.size());
+    m_addresses.resize(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        m_values[i] = keys.at(i) >> 32;
+        m_addresses[i] = keys.at(i) & 0xffffffff;
+    }
+}
+
+QVector<VIRTADDR> PointerIndex::pointers_to(const VIRTADDR &target) const {
+    const VIRTADDR *values = m_values.constData();
+    const VIRTADDR *end = values + m_values.size();
+    const VIRTADDR *first = qLowerBound(values, end, target);
+    const VIRTADDR *last = qUpperBound(first, end, target);
+    return m_addresses.mid(first - values, last - first);
+}
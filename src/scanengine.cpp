@@ -0,0 +1,350 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <algorithm>
+#include <string.h>
+#include "scanengine.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define NEEDLE_SSE2
+#define NEEDLE_AVX2
+#define NEEDLE_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define NEEDLE_SSE2
+#define NEEDLE_TARGET(isa)
+#include <emmintrin.h>
+#include <intrin.h>
+#endif
+
+/* All the searches report needle positions below limit, where the whole
+   needle fits inside bytes, in ascending order. */
+
+//! true if the middle of the needle (first and last bytes already match) does
+static inline bool needle_at(const char *data, int pos, const QByteArray &needle) {
+    int len = needle.size();
+    return len < 3 || memcmp(data + pos + 1, needle.constData() + 1, len - 2) == 0;
+}
+
+static void search_scalar_from(int from, const char *data, int bytes,
+                               int limit, const QByteArray &needle,
+                               const VIRTADDR &addr, QVector<VIRTADDR> &hits) {
+    int len = needle.size();
+    char first = needle.at(0);
+    char last = needle.at(len - 1);
+    int end = qMin(limit, bytes - len + 1);
+    for (int pos = from; pos < end; ++pos) {
+        const char *hit = (const char*)memchr(data + pos, first, end - pos);
+        if (!hit)
+            break;
+        pos = hit - data;
+        if (data[pos + len - 1] == last && needle_at(data, pos, needle))
+            hits << addr + pos;
+    }
+}
+
+static void search_scalar(const char *data, int bytes, int limit,
+                          const QByteArray &needle, const VIRTADDR &addr,
+                          QVector<VIRTADDR> &hits) {
+    search_scalar_from(0, data, bytes, limit, needle, addr, hits);
+}
+
+static inline int lowest_bit(uint mask) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return idx;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+#ifdef NEEDLE_SSE2
+NEEDLE_TARGET("sse2")
+static void search_sse2(const char *data, int bytes, int limit,
+                        const QByteArray &needle, const VIRTADDR &addr,
+                        QVector<VIRTADDR> &hits) {
+    int len = needle.size();
+    const __m128i first = _mm_set1_epi8(needle.at(0));
+    const __m128i last = _mm_set1_epi8(needle.at(len - 1));
+    // blocks where both the first and last byte loads stay in the buffer
+    int end = qMin(limit, bytes - len + 1);
+    int pos = 0;
+    for (; pos + 16 <= end; pos += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(data + pos));
+        __m128i b = _mm_loadu_si128((const __m128i*)(data + pos + len - 1));
+        uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                    _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            int bit = lowest_bit(mask);
+            if (needle_at(data, pos + bit, needle))
+                hits << addr + pos + bit;
+            mask &= mask - 1;
+        }
+    }
+    search_scalar_from(pos, data, bytes, limit, needle, addr, hits);
+}
+#endif
+
+#ifdef NEEDLE_AVX2
+NEEDLE_TARGET("avx2")
+static void search_avx2(const char *data, int bytes, int limit,
+                        const QByteArray &needle, const VIRTADDR &addr,
+                        QVector<VIRTADDR> &hits) {
+    int len = needle.size();
+    const __m256i first = _mm256_set1_epi8(needle.at(0));
+    const __m256i last = _mm256_set1_epi8(needle.at(len - 1));
+    int end = qMin(limit, bytes - len + 1);
+    int pos = 0;
+    for (; pos + 32 <= end; pos += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + pos));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + pos + len - 1));
+        uint mask = _mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                 _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            int bit = lowest_bit(mask);
+            if (needle_at(data, pos + bit, needle))
+                hits << addr + pos + bit;
+            mask &= mask - 1;
+        }
+    }
+    search_scalar_from(pos, data, bytes, limit, needle, addr, hits);
+}
+#endif
+
+NeedleKernel::NeedleKernel(const QByteArray &needle)
+    : m_needle(needle)
+    , m_search(search_scalar)
+    , m_search_name("scalar")
+{
+    // pick the widest search this CPU runs, once, so workers don't have to
+#if defined(NEEDLE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        m_search = search_avx2;
+        m_search_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        m_search = search_sse2;
+        m_search_name = "sse2";
+    }
+#elif defined(NEEDLE_SSE2)
+    int info[4];
+    __cpuid(info, 1);
+    if (info[3] & (1 << 26)) {
+        m_search = search_sse2;
+        m_search_name = "sse2";
+    }
+#endif
+}
+
+void NeedleKernel::scan(const VIRTADDR &addr, const char *data,
+                        int chunk_bytes, int bytes,
+                        QVector<VIRTADDR> &hits) const {
+    if (m_needle.isEmpty() || bytes < m_needle.size())
+        return;
+    m_search(data, bytes, chunk_bytes, m_needle, addr, hits);
+}
+
+PointerSetKernel::PointerSetKernel(const QVector<VIRTADDR> &targets)
+    : m_targets(targets)
+    , m_filter(0x10000)
+{
+    qSort(m_targets);
+    m_targets.erase(std::unique(m_targets.begin(), m_targets.end()),
+                    m_targets.end());
+    foreach(VIRTADDR val, m_targets) {
+        m_filter.setBit(filter_slot(val));
+    }
+}
+
+void PointerSetKernel::scan(const VIRTADDR &addr, const char *data,
+                            int chunk_bytes, int bytes,
+                            QVector<VIRTADDR> &hits) const {
+    if (m_targets.isEmpty())
+        return;
+    // every byte offset, like scanning for each encode()d value would
+    int end = qMin(chunk_bytes, bytes - (int)sizeof(VIRTADDR) + 1);
+    for (int pos = 0; pos < end; ++pos) {
+        VIRTADDR val;
+        memcpy(&val, data + pos, sizeof(val));
+        if (m_filter.testBit(filter_slot(val))
+            && qBinaryFind(m_targets, val) != m_targets.constEnd()) {
+            hits << addr + pos;
+        }
+    }
+}
+
+void VectorKernel::scan(const VIRTADDR &addr, const char *data,
+                        int chunk_bytes, int bytes,
+                        QVector<VIRTADDR> &hits) const {
+    MemorySpan<VIRTADDR> words(data, bytes);
+    for (int offset = 0; offset < chunk_bytes; offset += m_entry_size) {
+        VIRTADDR int1 = words.at_offset(offset);
+        VIRTADDR int2 = words.at_offset(offset + m_entry_size);
+        if (int1 && int2 && int2 >= int1 && int1 % 4 == 0 && int2 % 4 == 0) {
+            int entries = (int2 - int1) / m_entry_size;
+            if (entries >= m_min_entries && entries <= m_max_entries)
+                hits << addr + offset - m_pointer_offset;
+        }
+    }
+}
+
+void ValidPointerKernel::scan(const VIRTADDR &addr, const char *data,
+                              int chunk_bytes, int bytes,
+                              QVector<VIRTADDR> &hits) const {
+    if (m_starts.isEmpty())
+        return;
+    VIRTADDR lowest = m_starts.first();
+    VIRTADDR highest = m_ends.last();
+    const VIRTADDR *starts = m_starts.constData();
+    int end = qMin(chunk_bytes, bytes - (int)sizeof(VIRTADDR) + 1);
+    for (int pos = (4 - addr % 4) % 4; pos < end; pos += 4) {
+        VIRTADDR val;
+        memcpy(&val, data + pos, sizeof(val));
+        // most words are small integers or zero, skip those before searching
+        if (val < lowest || val > highest)
+            continue;
+        int idx = qUpperBound(starts, starts + m_starts.size(), val) - starts;
+        if (idx > 0 && val <= m_ends.at(idx - 1))
+            hits << val << addr + pos;
+    }
+}
+
+class ScanEngine::Worker : public QThread {
+public:
+    Worker(ScanEngine *engine, ScanReader *reader)
+        : m_engine(engine)
+        , m_reader(reader)
+    {}
+    ~Worker() {
+        delete m_reader;
+    }
+    QVector<VIRTADDR> hits; // sorted once the worker is done, if it can be
+
+protected:
+    void run() {
+        const ScanKernel *kernel = m_engine->m_kernel;
+        int overlap = kernel->overlap();
+        QByteArray buffer;
+        forever {
+            if (m_engine->m_cancelled)
+                break;
+            int idx = m_engine->m_next_chunk.fetchAndAddOrdered(1);
+            if (idx >= m_engine->m_chunks.size())
+                break;
+            const Chunk &c = m_engine->m_chunks.at(idx);
+            int readable = qMin<quint64>((quint64)c.limit - c.addr,
+                                         c.bytes + overlap);
+            if (buffer.size() < readable)
+                buffer.resize(readable);
+            if (m_reader->read(c.addr, readable, buffer.data()) > 0) {
+                kernel->scan(c.addr, buffer.constData(), c.bytes, readable,
+                             hits);
+            }
+            m_engine->m_kb_scanned.fetchAndAddRelaxed(c.bytes / 1024);
+        }
+        // ranges may not have been queued in address order
+        if (kernel->record_words() == 1)
+            qSort(hits);
+        m_engine->m_finished.release();
+    }
+
+private:
+    ScanEngine *m_engine;
+    ScanReader *m_reader;
+};
+
+ScanEngine::ScanEngine()
+    : m_total_bytes(0)
+    , m_kernel(0)
+    , m_worker_count(0)
+    , m_next_chunk(0)
+    , m_kb_scanned(0)
+    , m_cancelled(0)
+{}
+
+ScanEngine::~ScanEngine() {
+    cancel();
+    foreach(Worker *w, m_workers) {
+        w->wait();
+    }
+    qDeleteAll(m_workers);
+}
+
+void ScanEngine::add_range(const VIRTADDR &start, const VIRTADDR &end,
+                           const VIRTADDR &limit) {
+    quint64 addr = start;
+    while (addr < end) {
+        // keep chunks on page boundaries after the first one
+        quint64 chunk_end = qMin<quint64>(end, (addr & ~0xfffULL) + CHUNK_SIZE);
+        Chunk c;
+        c.addr = addr;
+        c.bytes = chunk_end - addr;
+        c.limit = limit;
+        m_chunks << c;
+        m_total_bytes += c.bytes;
+        addr = chunk_end;
+    }
+}
+
+void ScanEngine::start(ScanKernel *kernel, const QList<ScanReader*> &readers) {
+    m_kernel = kernel;
+    m_worker_count = readers.size();
+    foreach(ScanReader *reader, readers) {
+        Worker *w = new Worker(this, reader);
+        m_workers << w;
+        w->start();
+    }
+}
+
+bool ScanEngine::wait(int msecs) {
+    if (!m_finished.tryAcquire(m_worker_count, msecs))
+        return false;
+    m_finished.release(m_worker_count); // so asking again stays true
+    return true;
+}
+
+QVector<VIRTADDR> ScanEngine::results() {
+    QVector<VIRTADDR> merged;
+    if (m_kernel && m_kernel->record_words() > 1) {
+        // records can't be merged word by word, leave ordering to the caller
+        int total = 0;
+        foreach(Worker *w, m_workers) {
+            total += w->hits.size();
+        }
+        merged.reserve(total);
+        foreach(Worker *w, m_workers) {
+            merged << w->hits;
+            w->hits.clear();
+        }
+        return merged;
+    }
+    // every worker's hits are sorted already, merge them pairwise
+    foreach(Worker *w, m_workers) {
+        QVector<VIRTADDR> out(merged.size() + w->hits.size());
+        std::merge(merged.constBegin(), merged.constEnd(),
+                   w->hits.constBegin(), w->hits.constEnd(), out.begin());
+        merged = out;
+    }
+    return merged;
+}
@@ -26,25 +26,59 @@ THE SOFTWARE.
 #include "gamedatareader.h"
 #include "dwarftherapist.h"
 #include "scannerthread.h"
+#include "scannerconnection.h"
+#include "dfinstancesnapshot.h"
 #include "defines.h"
 #include "selectparentlayoutdialog.h"
 #include "layoutcreator.h"
+#include "layoutdiscovery.h"
+#include "diffscan.h"
+#include "scansession.h"
+#include "memorylayout.h"
 #include "word.h"
 
+static const char *SESSION_FILES =
+        "Dwarf Therapist Scan Sessions (*.dts);;All Files (*.*)";
+
 Scanner::Scanner(DFInstance *df, MainWindow *parent)
     : QDialog(parent)
     , m_df(df)
     , m_thread(0)
+    , m_discovery(0)
     , ui(new Ui::ScannerDialog)
     , m_stop_scanning(false)
+    , m_diff(0)
 {
     ui->setupUi(this);
     set_ui_enabled(true);
+    // scan the snapshot the main window has open rather than a live DF.
+    // Jobs get their own instance on the file, the main window's stays put
+    DFInstanceSnapshot *snapshot = qobject_cast<DFInstanceSnapshot*>(df);
+    ScannerConnection::use_snapshot(snapshot ? snapshot->filename()
+                                             : QString());
+    for (int i = 0; i < RESULT_SETS; ++i) {
+        m_next_row[i] = 0;
+    }
+    // differential searches scan with our own connection, not a thread
+    connect(m_df, SIGNAL(scan_total_steps(int)),
+            ui->pb_sub, SLOT(setMaximum(int)));
+    connect(m_df, SIGNAL(scan_progress(int)),
+            ui->pb_sub, SLOT(setValue(int)));
+    connect(m_df, SIGNAL(scan_message(const QString&)),
+            ui->lbl_scan_progress, SLOT(setText(const QString&)));
+}
+
+Scanner::~Scanner() {
+    ScannerConnection::close();
+    delete m_diff;
 }
 
 void Scanner::cancel_scan() {
     m_stop_scanning = true;
     m_df->cancel_scan();
+    ScannerConnection::cancel_scan();
+    if (m_discovery)
+        m_discovery->cancel();
 }
 
 void Scanner::set_ui_enabled(bool enabled) {
@@ -52,6 +86,8 @@ void Scanner::set_ui_enabled(bool enabled) {
     ui->gb_scan_targets->setEnabled(enabled);
     ui->gb_search->setEnabled(enabled);
     ui->gb_brute_force->setEnabled(enabled);
+    ui->gb_diff_search->setEnabled(enabled);
+    ui->gb_sessions->setEnabled(enabled);
     ui->gb_progress->setEnabled(!enabled);
     ui->btn_cancel_scan->setEnabled(!enabled);
     ui->lbl_scan_progress->setText(tr("Not Scanning"));
@@ -105,6 +141,7 @@ void Scanner::prepare_new_thread(SCANNER_JOB_TYPE type) {
 
     m_thread = new ScannerThread(m_df);
     m_thread->set_job(type);
+    ScannerConnection::lend_to(m_thread);
     connect(m_thread, SIGNAL(main_scan_total_steps(int)),
             ui->pb_main, SLOT(setMaximum(int)));
     connect(m_thread, SIGNAL(main_scan_progress(int)),
@@ -121,7 +158,9 @@ void Scanner::prepare_new_thread(SCANNER_JOB_TYPE type) {
             SLOT(report_offset(const QString&, const int&)));
 }
 
-void Scanner::run_thread_and_wait() {
+void Scanner::run_thread_and_wait(QVector<VIRTADDR> *result) {
+    if (result)
+        result->clear();
     if (!m_thread) {
         LOGW << "can't run a thread that was never set up! (m_thread == 0)";
         return;
@@ -135,6 +174,10 @@ void Scanner::run_thread_and_wait() {
     }
     m_thread->terminate();
     if (m_thread->wait(5000)) {
+        QVector<VIRTADDR> *found = (QVector<VIRTADDR> *)m_thread->get_result();
+        if (result && found)
+            *result = *found;
+        delete found;
         delete m_thread;
     } else {
         LOGE << "Scanning thread failed to stop for 5 seconds after killed!";
@@ -170,7 +213,8 @@ void Scanner::find_vector_by_length() {
     uint target_count = ui->sb_vector_entries->value();
     QString op = ui->btn_find_vector_operator->text();
 
-    ui->text_output->append(tr("Vectors %1 %2 entries").arg(op).arg(target_count));
+    m_vectors_search = tr("Vectors %1 %2 entries").arg(op).arg(target_count);
+    ui->text_output->append(m_vectors_search);
     prepare_new_thread(FIND_VECTORS_OF_SIZE);
 
     get_brute_force_address_range(params.start_addr, params.end_addr);
@@ -179,7 +223,9 @@ void Scanner::find_vector_by_length() {
 
     QByteArray needle((const char *)&params, sizeof(params));
     m_thread->set_meta(needle);
-    run_thread_and_wait();
+    run_thread_and_wait(&m_vectors);
+    m_next_row[VECTOR_HITS] = 0;
+    print_page(VECTOR_HITS);
     set_ui_enabled(true);
 }
 
@@ -224,30 +270,33 @@ void Scanner::create_memory_layout() {
 
         ScannerJob::m_layout_override_checksum = parent->checksum();
 
-        prepare_new_thread(FIND_DWARF_RACE_INDEX);
-        connect(m_thread, SIGNAL(found_address(const QString&, const quint32&)), creator,
-                SLOT(report_address(const QString&, const quint32&)));
-        run_thread_and_wait();
-
-        prepare_new_thread(FIND_TRANSLATIONS_VECTOR);
-        connect(m_thread, SIGNAL(found_address(const QString&, const quint32&)), creator,
-                SLOT(report_address(const QString&, const quint32&)));
-        run_thread_and_wait();
-
-        prepare_new_thread(FIND_CREATURE_VECTOR);
-        connect(m_thread, SIGNAL(found_address(const QString&, const quint32&)), creator,
-                SLOT(report_address(const QString&, const quint32&)));
-        run_thread_and_wait();
-
-        prepare_new_thread(FIND_CURRENT_YEAR);
-        connect(m_thread, SIGNAL(found_address(const QString&, const quint32&)), creator,
+        // independent searches run side by side, the creature vector waits
+        // for the race index so it can throw out vectors of non-dwarves
+        LayoutDiscovery discovery(m_df);
+        discovery.add_step(FIND_DWARF_RACE_INDEX);
+        discovery.add_step(FIND_TRANSLATIONS_VECTOR);
+        discovery.add_step(FIND_CREATURE_VECTOR,
+                           QList<SCANNER_JOB_TYPE>() << FIND_DWARF_RACE_INDEX,
+                           "Dwarf Race");
+        discovery.add_step(FIND_CURRENT_YEAR);
+        discovery.add_step(FIND_SQUADS_VECTOR);
+        connect(&discovery, SIGNAL(total_steps(int)),
+                ui->pb_main, SLOT(setMaximum(int)));
+        connect(&discovery, SIGNAL(steps_done(int)),
+                ui->pb_main, SLOT(setValue(int)));
+        connect(&discovery, SIGNAL(scan_message(const QString&)),
+                ui->lbl_scan_progress, SLOT(setText(const QString&)));
+        connect(&discovery, SIGNAL(found_address(const QString&, const quint32&)),
                 SLOT(report_address(const QString&, const quint32&)));
-        run_thread_and_wait();
-
-        prepare_new_thread(FIND_SQUADS_VECTOR);
-        connect(m_thread, SIGNAL(found_address(const QString&, const quint32&)), creator,
+        connect(&discovery, SIGNAL(found_offset(const QString&, const int&)),
+                SLOT(report_offset(const QString&, const int&)));
+        connect(&discovery, SIGNAL(found_address(const QString&, const quint32&)), creator,
                 SLOT(report_address(const QString&, const quint32&)));
-        run_thread_and_wait();
+        connect(&discovery, SIGNAL(found_offset(const QString&, const int&)), creator,
+                SLOT(report_offset(const QString&, const int&)));
+        m_discovery = &discovery;
+        discovery.run();
+        m_discovery = 0;
 
         ScannerJob::m_layout_override_checksum = "";
 
@@ -412,6 +461,8 @@ void Scanner::find_narrowing() {
         m_thread->clear_result();
         delete result;
     }
+    m_narrow_steps << QString::number(target_count);
+    m_next_row[NARROWING_HITS] = 0;
 
     delete m_thread;
     m_thread = 0;
@@ -422,25 +473,14 @@ void Scanner::find_narrowing() {
 void Scanner::reset_narrowing() {
     LOGD << "Reset narrowing search";
     m_narrow.clear();
+    m_narrow_steps.clear();
+    m_next_row[NARROWING_HITS] = 0;
     ui->lbl_narrowing_result->setText(tr("nil"));
     ui->le_narrowing_value->setText("");
 }
 
 void Scanner::print_narrowing() {
-    if(m_narrow.size() > 200) {
-        QString out = QString("<b><font color=red>There are a total of %1 vectors, only printing 200.</font></b>\n")
-            .arg(m_narrow.size());
-
-        ui->text_output->append(out);
-    }
-
-    int i = 0;
-    foreach(uint addr, m_narrow) {
-        report_address("vector found at", addr);
-
-        if(i++ >= 200)
-            break;
-    }
+    print_page(NARROWING_HITS);
 }
 
 void Scanner::find_squad_vector() {
@@ -469,3 +509,237 @@ void Scanner::find_current_year() {
     set_ui_enabled(true);
 }
 
+void Scanner::start_diff_scan() {
+    set_ui_enabled(false);
+    delete m_diff;
+    // 1, 2 or 4 bytes
+    m_diff = new DiffScan(1 << ui->cb_diff_size->currentIndex());
+    m_diff_steps = QStringList() << "snapshot";
+    m_next_row[DIFF_HITS] = 0;
+    if (!m_df->start_diff_scan(m_diff)) {
+        ui->text_output->append(tr("Snapshot cancelled, only part of "
+                                   "memory is being tracked."));
+    }
+    ui->lbl_diff_candidates->setText(QString("%L1")
+                                     .arg(m_diff->candidate_count()));
+    set_ui_enabled(true);
+}
+
+void Scanner::filter_diff_scan() {
+    if (!m_diff) {
+        start_diff_scan();
+        return;
+    }
+    set_ui_enabled(false);
+    bool ok;
+    qint32 value = ui->le_diff_value->text().toInt(&ok, 0);
+    int filter = ui->cb_diff_filter->currentIndex(); // same order as FILTER
+    if (filter == DiffScan::EQUALS && !ok) {
+        ui->text_output->append(tr("Enter the value to look for first."));
+    } else {
+        m_diff_steps << (filter == DiffScan::EQUALS ? QString::number(value)
+                         : ui->cb_diff_filter->currentText());
+        m_next_row[DIFF_HITS] = 0;
+        if (!m_df->filter_diff_scan(m_diff, filter, value)) {
+            ui->text_output->append(tr("Filter cancelled, the pages it "
+                                       "didn't reach kept their candidates."));
+        }
+    }
+    ui->lbl_diff_candidates->setText(QString("%L1")
+                                     .arg(m_diff->candidate_count()));
+    set_ui_enabled(true);
+}
+
+void Scanner::print_diff_scan() {
+    print_page(DIFF_HITS);
+}
+
+quint64 Scanner::result_count(RESULT_SET set) const {
+    switch (set) {
+    case VECTOR_HITS:
+        return m_vectors.size();
+    case NARROWING_HITS:
+        return m_narrow.size();
+    default:
+        return m_diff ? m_diff->candidate_count() : 0;
+    }
+}
+
+void Scanner::print_page(RESULT_SET set) {
+    quint64 total = result_count(set);
+    if (!total) {
+        ui->text_output->append(tr("Nothing found to print."));
+        return;
+    }
+    quint64 first = m_next_row[set] < total ? m_next_row[set] : 0;
+    quint64 last = qMin(first + PAGE_ROWS, total);
+    if (set == DIFF_HITS) {
+        QPair<VIRTADDR, qint32> c;
+        foreach(c, m_diff->candidates(PAGE_ROWS, first)) {
+            report_address(QString("value %1 at").arg(c.second), c.first);
+        }
+    } else {
+        const QVector<VIRTADDR> &hits = set == VECTOR_HITS ? m_vectors : m_narrow;
+        for (int i = (int)first; i < (int)last; ++i) {
+            report_address("vector found at", hits.at(i));
+        }
+    }
+    m_next_row[set] = last;
+    if (first > 0 || last < total) {
+        ui->text_output->append(tr("<b><font color=red>Printed %L1-%L2 of "
+                "%L3, print again for the next page.</font></b>\n")
+                .arg(first + 1).arg(last).arg(total));
+    }
+}
+
+QString Scanner::layout_checksum() {
+    return m_df->memory_layout() ? m_df->memory_layout()->checksum()
+                                 : QString();
+}
+
+ScanSession Scanner::session_for(RESULT_SET set) {
+    quint32 correction = m_df->get_memory_correction();
+    ScanSession session;
+    switch (set) {
+    case VECTOR_HITS:
+        session = ScanSession("vectors");
+        session.set_param("search", m_vectors_search);
+        session.set_hits(m_vectors, correction);
+        break;
+    case NARROWING_HITS:
+        session = ScanSession("narrowing");
+        session.set_param("steps", m_narrow_steps.join(","));
+        session.set_hits(m_narrow, correction);
+        break;
+    default:
+        session = ScanSession("diff");
+        session.set_param("steps", m_diff_steps.join(","));
+        if (m_diff) {
+            session.set_param("value size",
+                              QString::number(m_diff->value_size()));
+            QVector<VIRTADDR> addrs;
+            QVector<qint32> values;
+            m_diff->all_candidates(addrs, values);
+            session.set_hits(addrs, correction, values);
+        }
+        break;
+    }
+    session.set_checksum(layout_checksum());
+    return session;
+}
+
+bool Scanner::apply_session(RESULT_SET set, const ScanSession &session) {
+    QVector<VIRTADDR> addrs = session.addresses(m_df->get_memory_correction());
+    int value_size = session.param("value size").toInt();
+    if (set == DIFF_HITS && value_size != 1 && value_size != 2
+        && value_size != 4) {
+        ui->text_output->append(tr("<b><font color=red>The session's value "
+                "size (%1) isn't 1, 2 or 4 bytes, it can't resume a "
+                "differential search.</font></b>\n")
+                .arg(session.param("value size")));
+        return false;
+    }
+    switch (set) {
+    case VECTOR_HITS:
+        m_vectors = addrs;
+        m_vectors_search = session.param("search");
+        break;
+    case NARROWING_HITS:
+        m_narrow = addrs;
+        m_narrow_steps = session.param("steps").split(",",
+                                                      QString::SkipEmptyParts);
+        ui->lbl_narrowing_result->setText(QString("%1").arg(m_narrow.size()));
+        break;
+    default:
+        delete m_diff;
+        m_diff = new DiffScan(value_size);
+        m_diff->restore(addrs, session.values());
+        m_diff_steps = session.param("steps").split(",",
+                                                    QString::SkipEmptyParts);
+        // 1, 2 or 4 bytes
+        ui->cb_diff_size->setCurrentIndex(m_diff->value_size() / 2);
+        ui->lbl_diff_candidates->setText(QString("%L1")
+                                         .arg(m_diff->candidate_count()));
+        break;
+    }
+    m_next_row[set] = 0;
+    return true;
+}
+
+void Scanner::print_session() {
+    print_page((RESULT_SET)ui->cb_session_target->currentIndex());
+}
+
+void Scanner::save_session() {
+    RESULT_SET set = (RESULT_SET)ui->cb_session_target->currentIndex();
+    if (!result_count(set)) {
+        ui->text_output->append(tr("Nothing found to save."));
+        return;
+    }
+    QString path = QFileDialog::getSaveFileName(this,
+        tr("Choose where to save the scan session"), QString(), SESSION_FILES);
+    if (path.isEmpty())
+        return; // they cancelled
+    if (session_for(set).save(path)) {
+        ui->text_output->append(tr("Saved %L1 hits to %2")
+                                .arg(result_count(set)).arg(path));
+    } else {
+        ui->text_output->append(tr("Unable to save the scan session to %1. "
+                                   "See the log for details.").arg(path));
+    }
+}
+
+void Scanner::resume_session() {
+    load_session(false);
+}
+
+void Scanner::intersect_session() {
+    load_session(true);
+}
+
+void Scanner::load_session(bool intersect) {
+    RESULT_SET set = (RESULT_SET)ui->cb_session_target->currentIndex();
+    QString path = QFileDialog::getOpenFileName(this,
+        tr("Choose a scan session to open"), QString(), SESSION_FILES);
+    if (path.isEmpty())
+        return; // they cancelled
+    ScanSession loaded;
+    if (!loaded.load(path)) {
+        ui->text_output->append(tr("Unable to load the scan session %1. "
+                                   "See the log for details.").arg(path));
+        return;
+    }
+    QString checksum = layout_checksum();
+    if (!loaded.checksum().isEmpty() && !checksum.isEmpty()
+        && loaded.checksum() != checksum) {
+        ui->text_output->append(tr("<b><font color=red>%1 was saved against "
+                "another version of DF (%2), its addresses are unlikely to "
+                "mean anything here.</font></b>\n")
+                .arg(path).arg(loaded.checksum()));
+    }
+    if (set == DIFF_HITS && !intersect && !loaded.has_values()) {
+        ui->text_output->append(tr("Only a differential search session can "
+                "resume a differential search, the others have no values to "
+                "compare against."));
+        return;
+    }
+
+    if (set == DIFF_HITS && intersect && !m_diff) {
+        ui->text_output->append(tr("Take a snapshot before intersecting the "
+                                   "differential search with a session."));
+        return;
+    }
+
+    if (intersect) {
+        ScanSession current = session_for(set);
+        current.intersect(loaded);
+        if (apply_session(set, current)) {
+            ui->text_output->append(tr("%L1 hits are also in %2")
+                                    .arg(result_count(set)).arg(path));
+        }
+    } else if (apply_session(set, loaded)) {
+        ui->text_output->append(tr("Resumed %L1 %2 hits from %3")
+                                .arg(result_count(set)).arg(loaded.kind())
+                                .arg(path));
+    }
+}
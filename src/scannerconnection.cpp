@@ -0,0 +1,156 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "scannerconnection.h"
+#include "dfinstance.h"
+#include "dfinstancesnapshot.h"
+#include "truncatingfilelogger.h"
+
+QMutex ScannerConnection::m_lock;
+DFInstance *ScannerConnection::m_df = 0;
+MemoryLayout *ScannerConnection::m_layout = 0;
+bool ScannerConnection::m_connected = false;
+bool ScannerConnection::m_lent = false;
+QString ScannerConnection::m_snapshot;
+QPointer<QThread> ScannerConnection::m_holder;
+QList<DFInstance*> ScannerConnection::m_private;
+
+void ScannerConnection::adopt(DFInstance *df) {
+    QMutexLocker locker(&m_lock);
+    if (m_df && !m_lent && m_df != df)
+        delete m_df;
+    m_df = df;
+    m_connected = df->is_ok();
+    m_layout = df->memory_layout();
+    m_lent = false;
+    // private instances have to replay the same snapshot
+    DFInstanceSnapshot *snapshot = qobject_cast<DFInstanceSnapshot*>(df);
+    m_snapshot = snapshot ? snapshot->filename() : QString();
+}
+
+void ScannerConnection::use_snapshot(const QString &filename) {
+    QMutexLocker locker(&m_lock);
+    if (filename == m_snapshot)
+        return;
+    if (m_df && !m_lent)
+        delete m_df;
+    m_df = 0; // connected to the old source, a lent one is abandoned
+    m_layout = 0;
+    m_lent = false;
+    m_snapshot = filename;
+}
+
+DFInstance *ScannerConnection::new_instance() {
+    if (m_snapshot.isEmpty())
+        return DFInstance::newInstance();
+    return new DFInstanceSnapshot(m_snapshot);
+}
+
+void ScannerConnection::lend_to(QThread *thread) {
+    QMutexLocker locker(&m_lock);
+    if (!m_df)
+        return;
+    if (m_lent) {
+        if (m_holder && !m_holder->isFinished())
+            return; // still busy, or not started yet
+        // the last job never gave it back (its thread was killed), it
+        // can't be trusted now. Leave it be and connect again next time
+        LOGW << "scanner connection wasn't returned, reconnecting";
+        m_df = 0;
+        m_lent = false;
+        return;
+    }
+    m_df->moveToThread(thread);
+    m_holder = thread;
+    m_lent = true;
+}
+
+DFInstance *ScannerConnection::borrow(bool *ok) {
+    QMutexLocker locker(&m_lock);
+    if (!m_df) {
+        // first job, connect on its thread so the instance already lives
+        // where it's used
+        m_df = new_instance();
+        m_connected = m_df->find_running_copy(true);
+        m_layout = m_df->memory_layout();
+        if (!m_connected) {
+            DFInstance *df = m_df;
+            m_df = 0;
+            *ok = false;
+            return df;
+        }
+        m_holder = QThread::currentThread();
+        m_lent = true;
+    } else if (!m_lent || m_holder != QThread::currentThread()) {
+        LOGD << "scanner connection is lent out, connecting a private one";
+        DFInstance *df = new_instance();
+        *ok = df->find_running_copy(true);
+        m_private << df;
+        return df;
+    } else {
+        // DF kept running since the last job
+        m_df->request_remap();
+    }
+    *ok = m_connected;
+    return m_df;
+}
+
+void ScannerConnection::give_back(DFInstance *df) {
+    QMutexLocker locker(&m_lock);
+    if (!df)
+        return;
+    if (df != m_df) {
+        m_private.removeAll(df);
+        delete df;
+        return;
+    }
+    // forget whoever the last job's signals went to
+    QObject::disconnect(df, 0, 0, 0);
+    df->set_memory_layout(m_layout);
+    df->drop_pointer_index();
+    df->moveToThread(QCoreApplication::instance()->thread());
+    m_lent = false;
+}
+
+bool ScannerConnection::allows_concurrent_jobs() {
+    QMutexLocker locker(&m_lock);
+    return m_df && m_connected && !m_df->exclusive_attach();
+}
+
+void ScannerConnection::cancel_scan() {
+    QMutexLocker locker(&m_lock);
+    if (m_df && m_lent)
+        m_df->cancel_scan();
+    foreach(DFInstance *df, m_private) {
+        df->cancel_scan();
+    }
+}
+
+void ScannerConnection::close() {
+    QMutexLocker locker(&m_lock);
+    if (m_df && !m_lent)
+        delete m_df;
+    m_df = 0;
+    m_layout = 0;
+    m_lent = false;
+    m_snapshot.clear();
+}
@@ -22,6 +22,7 @@ THE SOFTWARE.
 */
 #include "scannerjob.h"
 #include "dfinstance.h"
+#include "scannerconnection.h"
 
 ScannerJob::ScannerJob(SCANNER_JOB_TYPE job_type)
     : m_job_type(job_type)
@@ -29,8 +30,7 @@ ScannerJob::ScannerJob(SCANNER_JOB_TYPE job_type)
     m_ok = get_DFInstance();
 }
 ScannerJob::~ScannerJob() {
-    if (m_df)
-        delete m_df;
+    ScannerConnection::give_back(m_df);
     m_df = 0;
 }
 
@@ -45,8 +45,8 @@ DFInstance *ScannerJob::df() {
 QString ScannerJob::m_layout_override_checksum("");
 
 bool ScannerJob::get_DFInstance() {
-    m_df = DFInstance::newInstance();
-    bool result = m_df->find_running_copy(true);
+    bool result = false;
+    m_df = ScannerConnection::borrow(&result);
 
     if(!m_layout_override_checksum.isEmpty()) {
         m_df->set_memory_layout(m_df->get_memory_layout(m_layout_override_checksum, false));
@@ -0,0 +1,215 @@
+/*
+Dwarf Therapist
+Copyright (c) 2009 Trey Stout (chmod)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <string.h>
+#include "scansession.h"
+#include "truncatingfilelogger.h"
+
+const char *ScanSession::MAGIC = "DTSCNSES";
+
+// hits are close together, so the gaps between them mostly fit in a byte or
+// two as 7 bit groups
+static void put_varint(QByteArray &out, quint32 val) {
+    while (val >= 0x80) {
+        out.append((char)((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    out.append((char)val);
+}
+
+static bool get_varint(const uchar *&p, const uchar *end, quint32 &val) {
+    val = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uchar b = *p++;
+        val |= (quint32)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// small negative values stay small
+static quint32 zigzag(qint32 val) {
+    return ((quint32)val << 1) ^ (quint32)(val >> 31);
+}
+
+static qint32 unzigzag(quint32 val) {
+    return (qint32)(val >> 1) ^ -(qint32)(val & 1);
+}
+
+ScanSession::ScanSession(const QString &kind)
+    : m_kind(kind)
+{}
+
+void ScanSession::set_param(const QString &key, const QString &value) {
+    m_params.insert(key, value);
+}
+
+QVector<VIRTADDR> ScanSession::addresses(quint32 memory_correction) const {
+    QVector<VIRTADDR> addrs(m_addrs.size());
+    for (int i = 0; i < m_addrs.size(); ++i) {
+        addrs[i] = m_addrs.at(i) + memory_correction;
+    }
+    return addrs;
+}
+
+void ScanSession::set_hits(const QVector<VIRTADDR> &addrs,
+                           quint32 memory_correction,
+                           const QVector<qint32> &values) {
+    m_addrs.resize(addrs.size());
+    m_values.clear();
+    if (values.isEmpty()) {
+        for (int i = 0; i < addrs.size(); ++i) {
+            m_addrs[i] = addrs.at(i) - memory_correction;
+        }
+        qSort(m_addrs);
+        return;
+    }
+
+    // pack each hit with its value so one sort keeps them together
+    QVector<quint64> keys(addrs.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        keys[i] = ((quint64)(addrs.at(i) - memory_correction) << 32)
+                  | (quint32)values.at(i);
+    }
+    qSort(keys);
+    m_values.resize(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        m_addrs[i] = keys.at(i) >> 32;
+        m_values[i] = (qint32)(keys.at(i) & 0xffffffff);
+    }
+}
+
+void ScanSession::intersect(const ScanSession &other) {
+    QVector<VIRTADDR> addrs;
+    QVector<qint32> values;
+    int j = 0;
+    for (int i = 0; i < m_addrs.size(); ++i) {
+        while (j < other.m_addrs.size() && other.m_addrs.at(j) < m_addrs.at(i))
+            ++j;
+        if (j == other.m_addrs.size())
+            break;
+        if (other.m_addrs.at(j) == m_addrs.at(i)) {
+            addrs << m_addrs.at(i);
+            if (has_values())
+                values << m_values.at(i);
+        }
+    }
+    LOGD << "intersecting" << m_kind << "with" << other.kind() << "kept"
+            << addrs.size() << "of" << m_addrs.size() << "hits";
+    m_addrs = addrs;
+    m_values = values;
+}
+
+bool ScanSession::save(const QString &filename) const {
+    QFile f(filename);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        LOGE << "Unable to open" << filename << "for writing";
+        return false;
+    }
+
+    QByteArray packed;
+    packed.reserve(m_addrs.size() * (has_values() ? 3 : 2));
+    VIRTADDR last = 0;
+    for (int i = 0; i < m_addrs.size(); ++i) {
+        put_varint(packed, m_addrs.at(i) - last);
+        last = m_addrs.at(i);
+        if (has_values())
+            put_varint(packed, zigzag(m_values.at(i)));
+    }
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_4_5);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(MAGIC, 8);
+    out << FORMAT_VERSION << m_kind << m_checksum << m_params
+        << (quint32)m_addrs.size() << (has_values() ? HAS_VALUES : 0)
+        << packed;
+    f.close();
+    LOGI << "saved" << m_addrs.size() << m_kind << "hits (" << packed.size()
+            << "bytes) to" << filename;
+    return out.status() == QDataStream::Ok;
+}
+
+bool ScanSession::load(const QString &filename) {
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly)) {
+        LOGE << "Unable to open scan session" << filename;
+        return false;
+    }
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_4_5);
+    in.setByteOrder(QDataStream::LittleEndian);
+    char magic[8];
+    if (in.readRawData(magic, 8) != 8 || memcmp(magic, MAGIC, 8) != 0) {
+        LOGE << filename << "is not a scan session";
+        return false;
+    }
+    quint32 version;
+    in >> version;
+    if (version != FORMAT_VERSION) {
+        LOGE << "scan session version" << version << "is not supported";
+        return false;
+    }
+
+    QString kind;
+    QString checksum;
+    QMap<QString, QString> params;
+    quint32 count;
+    quint32 flags;
+    QByteArray packed;
+    in >> kind >> checksum >> params >> count >> flags >> packed;
+    // every hit takes at least a byte, don't trust count any further
+    if (in.status() != QDataStream::Ok || count > (quint32)packed.size()) {
+        LOGE << "scan session" << filename << "is truncated";
+        return false;
+    }
+
+    QVector<VIRTADDR> addrs(count);
+    QVector<qint32> values(flags & HAS_VALUES ? count : 0);
+    const uchar *p = (const uchar *)packed.constData();
+    const uchar *end = p + packed.size();
+    VIRTADDR last = 0;
+    for (quint32 i = 0; i < count; ++i) {
+        quint32 delta;
+        quint32 val = 0;
+        if (!get_varint(p, end, delta)
+            || (!values.isEmpty() && !get_varint(p, end, val))) {
+            LOGE << "scan session" << filename << "is damaged after" << i
+                    << "of" << count << "hits";
+            return false;
+        }
+        last += delta;
+        addrs[i] = last;
+        if (!values.isEmpty())
+            values[i] = unzigzag(val);
+    }
+
+    m_kind = kind;
+    m_checksum = checksum;
+    m_params = params;
+    m_addrs = addrs;
+    m_values = values;
+    LOGI << "loaded" << count << kind << "hits from" << filename;
+    return true;
+}